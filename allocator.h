@@ -37,11 +37,17 @@
 extern "C" {
 
 #endif
-
 #include "stddef.h"
+#include "stdint.h"
 #include "stdlib.h"
+#include "string.h"
+#include "errno.h"
 #include "inline.h"
 #include "callconv.h"
+#include "threads.h"
+#include "stdatomic.h"
+#include "stdio.h"
+#include "selectany.h"
 
 #if defined(NOCL_FEATURE_NO_STDDEF) || defined(NOCL_FEATURE_NO_STDLIB)
 
@@ -82,28 +88,95 @@ __inline void *__cdecl aligned_calloc(size_t num, size_t size, size_t alignment)
     /* POSIX.1-2001 */ ((defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200112L) || \
 	/* UNIX03 */ (defined(_XOPEN_SOURCE) && _XOPEN_SOURCE >= 600))
 
-inline void *aligned_malloc(size_t size, size_t alignment) {
-    void *res = malloc(size);
-    if (!res) return NULL;
+static inline void *aligned_malloc(size_t size, size_t alignment) {
+    void *res;
     int retval = posix_memalign(&res, alignment, size);
-    if (retval) errno = retval;
+    if (retval) {
+        errno = retval;
+        return NULL;
+    }
     return res;
 }
 
-inline void *aligned_calloc(size_t num, size_t size, size_t alignment) {
-    void *res = calloc(size);
-    if (!res) return NULL;
-    int retval = posix_memalign(&res, alignment, size);
-    if (retval) errno = retval;
+static inline void *aligned_calloc(size_t num, size_t size, size_t alignment) {
+    if (size && num > (size_t) -1 / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    void *res = aligned_malloc(num * size, alignment);
+    if (res) memset(res, 0, num * size);
     return res;
 }
 
-inline void *aligned_malloc(void *ptr, size_t size, size_t alignment) {
-    void *res = realloc(ptr, size);
-    if (!res) return NULL;
-    int retval = posix_memalign(&res, alignment, size);
-    if (retval) errno = retval;
+/* Size of a heap block, where the C library can tell. */
+#if defined(__linux__)
+
+#include <malloc.h>
+
+#define __nocl_internal_allocator_usable_size  malloc_usable_size
+
+#elif defined(__APPLE__)
+
+#include <malloc/malloc.h>
+
+#define __nocl_internal_allocator_usable_size  malloc_size
+
+#elif defined(__FreeBSD__)
+
+#include <malloc_np.h>
+
+#define __nocl_internal_allocator_usable_size  malloc_usable_size
+
+#endif
+
+static inline void *aligned_realloc(void *ptr, size_t size, size_t alignment) {
+    void *res;
+    int retval;
+
+    if (!ptr) return aligned_malloc(size, alignment);
+
+    /* malloc alignment, which realloc keeps. */
+    if (alignment <= 2 * sizeof(void *)) return realloc(ptr, size);
+
+#if defined(__nocl_internal_allocator_usable_size)
+
+    /* realloc could lose the alignment; move the block instead, leaving 'ptr' intact on failure. */
+    size_t old_size = __nocl_internal_allocator_usable_size(ptr);
+    retval = posix_memalign(&res, alignment, size);
+    if (retval) {
+        errno = retval;
+        return NULL;
+    }
+    memcpy(res, ptr, old_size < size ? old_size : size);
+    free(ptr);
     return res;
+
+#else
+
+    /*
+     * Without the old size only realloc can copy, and it may free 'ptr':
+     * the fallback block is reserved first so a failure cannot lose the data.
+     */
+    void *aligned;
+    retval = posix_memalign(&aligned, alignment, size);
+    if (retval) {
+        errno = retval;
+        return NULL;
+    }
+    if (!((res = realloc(ptr, size)))) {
+        free(aligned);
+        return NULL;
+    }
+    if (!((size_t) res & (alignment - 1))) {
+        free(aligned);
+        return res;
+    }
+    memcpy(aligned, res, size);
+    free(res);
+    return aligned;
+
+#endif
+
 }
 
 #define aligned_free  free
@@ -114,7 +187,7 @@ inline void *aligned_malloc(void *ptr, size_t size, size_t alignment) {
 
 #if !defined(NOCL_FEATURE_NO_STDLIB)
 
-inline void *aligned_malloc(size_t size, size_t alignment) {
+static inline void *aligned_malloc(size_t size, size_t alignment) {
     void *original;
     void **aligned;
     int offset = alignment - 1 + sizeof(void *);
@@ -126,7 +199,7 @@ inline void *aligned_malloc(size_t size, size_t alignment) {
     return aligned;
 }
 
-inline void *aligned_calloc(size_t num, size_t size, size_t alignment) {
+static inline void *aligned_calloc(size_t num, size_t size, size_t alignment) {
     void *original;
     void **aligned;
     int offset = alignment - 1 + sizeof(void *);
@@ -138,19 +211,24 @@ inline void *aligned_calloc(size_t num, size_t size, size_t alignment) {
     return aligned;
 }
 
-inline void *aligned_realloc(void *ptr, size_t size, size_t alignment) {
+static inline void *aligned_realloc(void *ptr, size_t size, size_t alignment) {
     void *original;
     void **aligned;
     int offset = alignment - 1 + sizeof(void *);
     size_t n = size + offset;
     if (n < size) return NULL;
-    if (!((original = realloc(ptr, n)))) return NULL;
+    if (!ptr) return aligned_malloc(size, alignment);
+    size_t shift = (size_t) ptr - (size_t) ((void **) ptr)[-1];
+    if (!((original = realloc(((void **) ptr)[-1], n)))) return NULL;
     aligned = (void **) (((size_t) (original) + offset) & ~(alignment - 1));
+    /* The block may have moved to an address with a different misalignment. */
+    if ((size_t) aligned - (size_t) original != shift)
+        memmove(aligned, (unsigned char *) original + shift, size);
     aligned[-1] = original;
     return aligned;
 }
 
-inline void aligned_free(void *ptr) {
+static inline void aligned_free(void *ptr) {
     free(((void **) ptr)[-1]);
 }
 
@@ -158,22 +236,305 @@ inline void aligned_free(void *ptr) {
 
 #endif
 
+/* Alignment of blocks handed out by the backends below. */
+#define __NOCL_INTERNAL_ALLOCATOR_ALIGN  (2 * sizeof(void *))
+
+#define __nocl_internal_allocator_align_up(n,alignment)  (((n) + ((alignment) - 1)) & ~((size_t) (alignment) - 1))
+
+/*
+ * Large allocations.
+ *
+ * At or above NOCL_ALLOCATOR_LARGE_THRESHOLD bytes, blocks are mapped
+ * directly from the OS where mmap is available, optionally backed by huge
+ * pages. Smaller blocks, and every block on systems without mmap, come from
+ * the heap. Blocks must be released with 'aligned_free_large'.
+ */
+
+#if !defined(NOCL_ALLOCATOR_LARGE_THRESHOLD)
+
+#define NOCL_ALLOCATOR_LARGE_THRESHOLD  ((size_t) 1 << 20)
+
+#endif
+
+#define ALIGNED_LARGE_DEFAULT  0
+#define ALIGNED_LARGE_HUGE     1  /* Transparent huge pages, where supported. */
+#define ALIGNED_LARGE_HUGETLB  2  /* Reserved huge pages; falls back to ALIGNED_LARGE_HUGE. */
+
+#define __NOCL_INTERNAL_ALLOCATOR_HUGE_PAGE_SIZE  ((size_t) 2 << 20)
+
+#if \
+    /* POSIX.1-2001 */ ((defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200112L) || \
+	/* UNIX03 */ (defined(_XOPEN_SOURCE) && _XOPEN_SOURCE >= 600))
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(MAP_ANONYMOUS) || defined(MAP_ANON)
+
+#define __NOCL_INTERNAL_ALLOCATOR_HAS_MMAP
+
+#if !defined(MAP_ANONYMOUS)
+
+#define MAP_ANONYMOUS  MAP_ANON
+
+#endif
+
+#endif
+
+#endif
+
+/*
+ * Stored immediately before every block; 'length' is 0 for heap blocks and
+ * 'flags' records the kind of pages actually obtained.
+ */
+struct __nocl_internal_allocator_large_header {
+    void *base;
+    size_t length;
+    size_t size;
+    int flags;
+};
+
+#define __nocl_internal_allocator_large_header_of(ptr) \
+    ((struct __nocl_internal_allocator_large_header *) (ptr) - 1)
+
+#if defined(__NOCL_INTERNAL_ALLOCATOR_HAS_MMAP)
+
+static inline void *cdecl __nocl_internal_allocator_large_map(size_t size, size_t alignment, int flags) {
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t granule = page;
+    size_t offset = __nocl_internal_allocator_align_up(sizeof(struct __nocl_internal_allocator_large_header), alignment);
+    void *base = MAP_FAILED;
+
+    if (flags & (ALIGNED_LARGE_HUGE | ALIGNED_LARGE_HUGETLB)) granule = __NOCL_INTERNAL_ALLOCATOR_HUGE_PAGE_SIZE;
+    size_t region_alignment = alignment > granule ? alignment : granule;
+
+    if (size > (size_t) -1 - offset - 2 * region_alignment) return NULL;
+    size_t length = __nocl_internal_allocator_align_up(offset + size, granule);
+    size_t extra = region_alignment - page;
+    int kind = granule != page ? ALIGNED_LARGE_HUGE : ALIGNED_LARGE_DEFAULT;
+
+#if defined(MAP_HUGETLB)
+
+    /* The kernel aligns these to the huge page size already. */
+    if (flags & ALIGNED_LARGE_HUGETLB) {
+        extra = region_alignment - granule;
+        base = mmap(NULL, length + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base == MAP_FAILED) extra = region_alignment - page;
+        else kind = ALIGNED_LARGE_HUGETLB;
+    }
+
+#endif
+
+    if (base == MAP_FAILED) {
+        base = mmap(NULL, length + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) return NULL;
+
+#if defined(MADV_HUGEPAGE)
+
+        if (granule != page) madvise(base, length + extra, MADV_HUGEPAGE);
+
+#endif
+
+    }
+
+    /* Trim the slack around the aligned region. */
+    unsigned char *region = (unsigned char *) __nocl_internal_allocator_align_up((size_t) base, region_alignment);
+    size_t head = (size_t) (region - (unsigned char *) base);
+    if (head) munmap(base, head);
+    if (extra - head) munmap(region + length, extra - head);
+
+    unsigned char *res = region + offset;
+    __nocl_internal_allocator_large_header_of(res)->base = region;
+    __nocl_internal_allocator_large_header_of(res)->length = length;
+    __nocl_internal_allocator_large_header_of(res)->size = size;
+    __nocl_internal_allocator_large_header_of(res)->flags = kind;
+    return res;
+}
+
+#endif
+
+/* 'alignment' must be a power of two. */
+static inline void *cdecl aligned_malloc_large(size_t size, size_t alignment, int flags) {
+    if (alignment < sizeof(void *)) alignment = sizeof(void *);
+
+#if defined(__NOCL_INTERNAL_ALLOCATOR_HAS_MMAP)
+
+    if (size >= NOCL_ALLOCATOR_LARGE_THRESHOLD) return __nocl_internal_allocator_large_map(size, alignment, flags);
+
+#else
+
+    (void) flags;
+
+#endif
+
+    size_t offset = alignment - 1 + sizeof(struct __nocl_internal_allocator_large_header);
+    if (size > (size_t) -1 - offset) return NULL;
+
+    unsigned char *base = malloc(size + offset);
+    if (!base) return NULL;
+
+    unsigned char *res = (unsigned char *) __nocl_internal_allocator_align_up((size_t) base + sizeof(struct __nocl_internal_allocator_large_header), alignment);
+    __nocl_internal_allocator_large_header_of(res)->base = base;
+    __nocl_internal_allocator_large_header_of(res)->length = 0;
+    __nocl_internal_allocator_large_header_of(res)->size = size;
+    __nocl_internal_allocator_large_header_of(res)->flags = ALIGNED_LARGE_DEFAULT;
+    return res;
+}
+
+static inline void *cdecl aligned_calloc_large(size_t num, size_t size, size_t alignment, int flags) {
+    if (size && num > (size_t) -1 / size) return NULL;
+    void *res = aligned_malloc_large(num * size, alignment, flags);
+    if (!res) return NULL;
+
+    /* Fresh mappings are already zeroed. */
+    if (!__nocl_internal_allocator_large_header_of(res)->length) memset(res, 0, num * size);
+    return res;
+}
+
+static inline void cdecl aligned_free_large(void *ptr) {
+    if (!ptr) return;
+
+    struct __nocl_internal_allocator_large_header *header = __nocl_internal_allocator_large_header_of(ptr);
+
+#if defined(__NOCL_INTERNAL_ALLOCATOR_HAS_MMAP)
+
+    if (header->length) {
+        munmap(header->base, header->length);
+        return;
+    }
+
+#endif
+
+    free(header->base);
+}
+
+/* Resize a heap block whose data sits 'offset' bytes into the allocation at 'base'. */
+static inline void *cdecl __nocl_internal_allocator_large_heap_realloc(void *base, size_t offset, size_t old_size, size_t size, size_t alignment) {
+    size_t slack = alignment - 1 + sizeof(struct __nocl_internal_allocator_large_header);
+
+    /* A block allocated with a larger alignment keeps its data further in. */
+    if (slack < offset) slack = offset;
+    if (size > (size_t) -1 - slack) return NULL;
+
+    unsigned char *block = realloc(base, size + slack);
+    if (!block) return NULL;
+
+    unsigned char *res = (unsigned char *) __nocl_internal_allocator_align_up((size_t) block + sizeof(struct __nocl_internal_allocator_large_header), alignment);
+    if (res != block + offset) memmove(res, block + offset, old_size < size ? old_size : size);
+    __nocl_internal_allocator_large_header_of(res)->base = block;
+    __nocl_internal_allocator_large_header_of(res)->length = 0;
+    __nocl_internal_allocator_large_header_of(res)->size = size;
+    __nocl_internal_allocator_large_header_of(res)->flags = ALIGNED_LARGE_DEFAULT;
+    return res;
+}
+
+static inline void *cdecl aligned_realloc_large(void *ptr, size_t size, size_t alignment, int flags) {
+    if (!ptr) return aligned_malloc_large(size, alignment, flags);
+    if (alignment < sizeof(void *)) alignment = sizeof(void *);
+
+    struct __nocl_internal_allocator_large_header *header = __nocl_internal_allocator_large_header_of(ptr);
+    size_t old_size = header->size;
+    size_t offset = (size_t) ((unsigned char *) ptr - (unsigned char *) header->base);
+
+#if defined(__NOCL_INTERNAL_ALLOCATOR_HAS_MMAP) && defined(MREMAP_MAYMOVE)
+
+    int kind = header->flags;
+
+    /* Resize mappings through the page tables instead of copying. */
+    if (header->length && !(kind & ALIGNED_LARGE_HUGETLB) && !(offset & (alignment - 1))) {
+        size_t page = (size_t) sysconf(_SC_PAGESIZE);
+        size_t granule = (kind & ALIGNED_LARGE_HUGE) ? __NOCL_INTERNAL_ALLOCATOR_HUGE_PAGE_SIZE : page;
+        if (size > (size_t) -1 - offset - granule) return NULL;
+        size_t length = __nocl_internal_allocator_align_up(offset + size, granule);
+
+        void *region = mremap(header->base, header->length, length, 0);
+        if (region == MAP_FAILED && alignment <= page)
+            region = mremap(header->base, header->length, length, MREMAP_MAYMOVE);
+
+        if (region != MAP_FAILED) {
+
+#if defined(MADV_HUGEPAGE)
+
+            if (kind & ALIGNED_LARGE_HUGE) madvise(region, length, MADV_HUGEPAGE);
+
+#endif
+
+            ptr = (unsigned char *) region + offset;
+            header = __nocl_internal_allocator_large_header_of(ptr);
+            header->base = region;
+            header->length = length;
+            header->size = size;
+            return ptr;
+        }
+    }
+
+#endif
+
+    /* Heap blocks that stay below the threshold keep their place where possible. */
+    if (!header->length && size < NOCL_ALLOCATOR_LARGE_THRESHOLD)
+        return __nocl_internal_allocator_large_heap_realloc(header->base, offset, old_size, size, alignment);
+
+    void *res = aligned_malloc_large(size, alignment, flags);
+    if (!res) return NULL;
+    memcpy(res, ptr, old_size < size ? old_size : size);
+    aligned_free_large(ptr);
+    return res;
+}
+
 typedef void *(*ator_malloc_t)  (size_t);
 typedef void *(*ator_calloc_t)  (size_t, size_t);
 typedef void *(*ator_realloc_t) (void *, size_t);
 typedef void  (*ator_free_t)    (void *);
 
+struct ator_t;
+
+/* Hooks for stateful backends, which receive the allocator itself. */
+typedef void *(*ator_malloc_ex_t)  (struct ator_t *, size_t);
+typedef void *(*ator_calloc_ex_t)  (struct ator_t *, size_t, size_t);
+typedef void *(*ator_realloc_ex_t) (struct ator_t *, void *, size_t);
+typedef void  (*ator_free_ex_t)    (struct ator_t *, void *);
+typedef void  (*ator_destroy_ex_t) (struct ator_t *);
+
+/* Optional batch hooks; 'ator_malloc_batch' and 'ator_free_batch' loop when unset. */
+typedef size_t (*ator_malloc_batch_ex_t) (struct ator_t *, size_t, size_t, void **);
+typedef void   (*ator_free_batch_ex_t)   (struct ator_t *, void **, size_t);
+
+typedef struct ator_trim_stats_t {
+    size_t retained;  /* Free bytes currently held that trimming could release. */
+    size_t trimmed;   /* Bytes released to the OS so far. */
+    size_t reused;    /* Released bytes that had to be taken back into use later. */
+} ator_trim_stats_t;
+
+/*
+ * Optional trim hook: release retained memory down to the given number of
+ * bytes, fill in the stats if not NULL, and return the bytes released.
+ */
+typedef size_t (*ator_trim_ex_t) (struct ator_t *, size_t, ator_trim_stats_t *);
+
 typedef struct ator_t {
     ator_malloc_t  f_malloc;
     ator_calloc_t  f_calloc;
     ator_realloc_t f_realloc;
     ator_free_t    f_free;
+
+    /* Take precedence over the plain hooks when set. */
+    ator_malloc_ex_t  f_malloc_ex;
+    ator_calloc_ex_t  f_calloc_ex;
+    ator_realloc_ex_t f_realloc_ex;
+    ator_free_ex_t    f_free_ex;
+    ator_destroy_ex_t f_destroy_ex;
+
+    ator_malloc_batch_ex_t f_malloc_batch_ex;
+    ator_free_batch_ex_t   f_free_batch_ex;
+
+    ator_trim_ex_t f_trim_ex;
 } ator_t;
 
 #define ATOR_DEFAULT  ((void *)  0)
 #define ATOR_ALIGNED  ((void *) -1)
+#define ATOR_HUGE     ((void *) -2)
 
-inline ator_t cdecl *ator_create(
+static inline ator_t cdecl *ator_create(
     ator_malloc_t malloc_fn,
     ator_calloc_t calloc_fn,
     ator_realloc_t realloc_fn,
@@ -188,38 +549,2367 @@ inline ator_t cdecl *ator_create(
     ator->f_realloc = realloc_fn ? realloc_fn : realloc;
     ator->f_free    = free_fn    ? free_fn    : free;
 
+    ator->f_malloc_ex  = NULL;
+    ator->f_calloc_ex  = NULL;
+    ator->f_realloc_ex = NULL;
+    ator->f_free_ex    = NULL;
+    ator->f_destroy_ex = NULL;
+
+    ator->f_malloc_batch_ex = NULL;
+    ator->f_free_batch_ex   = NULL;
+
+    ator->f_trim_ex = NULL;
+
     return ator;
 }
 
-inline void cdecl ator_destroy(ator_t *ator) {
-    if (!ator || ator == ATOR_ALIGNED) return;
-    free(ator);
+static inline void cdecl ator_destroy(ator_t *ator) {
+    if (!ator || ator == ATOR_ALIGNED || ator == ATOR_HUGE) return;
+    if (ator->f_destroy_ex) ator->f_destroy_ex(ator);
+    else free(ator);
 }
 
-inline void *cdecl ator_malloc(ator_t *ator, size_t size) {
+static inline void *cdecl ator_malloc(ator_t *ator, size_t size) {
     if (!ator) return malloc(size);
     else if (ator == ATOR_ALIGNED) return aligned_malloc(size, sizeof(void *));
+    else if (ator == ATOR_HUGE) return aligned_malloc_large(size, __NOCL_INTERNAL_ALLOCATOR_ALIGN, ALIGNED_LARGE_HUGE);
+    else if (ator->f_malloc_ex) return ator->f_malloc_ex(ator, size);
     else return ator->f_malloc(size);
 }
 
-inline void *cdecl ator_calloc(ator_t *ator, size_t num, size_t size) {
+static inline void *cdecl ator_calloc(ator_t *ator, size_t num, size_t size) {
     if (!ator) return calloc(num, size);
     else if (ator == ATOR_ALIGNED) return aligned_calloc(num, size, sizeof(void *));
+    else if (ator == ATOR_HUGE) return aligned_calloc_large(num, size, __NOCL_INTERNAL_ALLOCATOR_ALIGN, ALIGNED_LARGE_HUGE);
+    else if (ator->f_calloc_ex) return ator->f_calloc_ex(ator, num, size);
     else return ator->f_calloc(num, size);
 }
 
-inline void *cdecl ator_realloc(ator_t *ator, void *ptr, size_t size) {
+static inline void *cdecl ator_realloc(ator_t *ator, void *ptr, size_t size) {
     if (!ator) return realloc(ptr, size);
     else if (ator == ATOR_ALIGNED) return aligned_realloc(ptr, size, sizeof(void *));
+    else if (ator == ATOR_HUGE) return aligned_realloc_large(ptr, size, __NOCL_INTERNAL_ALLOCATOR_ALIGN, ALIGNED_LARGE_HUGE);
+    else if (ator->f_realloc_ex) return ator->f_realloc_ex(ator, ptr, size);
     else return ator->f_realloc(ptr, size);
 }
 
-inline void cdecl ator_free(ator_t *ator, void *ptr) {
+static inline void cdecl ator_free(ator_t *ator, void *ptr) {
     if (!ator) free(ptr);
     else if (ator == ATOR_ALIGNED) return aligned_free(ptr);
+    else if (ator == ATOR_HUGE) return aligned_free_large(ptr);
+    else if (ator->f_free_ex) ator->f_free_ex(ator, ptr);
     else ator->f_free(ptr);
 }
 
+/*
+ * Statically dispatched allocators.
+ *
+ * NOCL_DEFINE_STATIC_ATOR(name, ...) emits 'name_malloc', 'name_calloc',
+ * 'name_realloc' and 'name_free', which call the given functions directly
+ * and can be inlined, plus 'name_ator()' returning an equivalent 'ator_t'
+ * for code that takes one. Defining NOCL_FEATURE_NO_STATIC_ATOR before the
+ * macro is expanded routes the same names through the 'ator_t' instead, so
+ * a translation unit can switch without touching its call sites.
+ */
+
+#define __nocl_internal_allocator_static_ator_vtable(name,malloc_fn,calloc_fn,realloc_fn,free_fn) \
+    static ator_t name##_vtable = { \
+        (malloc_fn), (calloc_fn), (realloc_fn), (free_fn), \
+        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL \
+    }; \
+    static forceinline ator_t *name##_ator(void) { return &name##_vtable; }
+
+#if defined(NOCL_FEATURE_NO_STATIC_ATOR)
+
+#define NOCL_DEFINE_STATIC_ATOR(name,malloc_fn,calloc_fn,realloc_fn,free_fn) \
+    __nocl_internal_allocator_static_ator_vtable(name, malloc_fn, calloc_fn, realloc_fn, free_fn) \
+    static forceinline void *name##_malloc(size_t size) { return ator_malloc(&name##_vtable, size); } \
+    static forceinline void *name##_calloc(size_t num, size_t size) { return ator_calloc(&name##_vtable, num, size); } \
+    static forceinline void *name##_realloc(void *ptr, size_t size) { return ator_realloc(&name##_vtable, ptr, size); } \
+    static forceinline void name##_free(void *ptr) { ator_free(&name##_vtable, ptr); }
+
+#else
+
+#define NOCL_DEFINE_STATIC_ATOR(name,malloc_fn,calloc_fn,realloc_fn,free_fn) \
+    __nocl_internal_allocator_static_ator_vtable(name, malloc_fn, calloc_fn, realloc_fn, free_fn) \
+    static forceinline void *name##_malloc(size_t size) { return (malloc_fn)(size); } \
+    static forceinline void *name##_calloc(size_t num, size_t size) { return (calloc_fn)(num, size); } \
+    static forceinline void *name##_realloc(void *ptr, size_t size) { return (realloc_fn)(ptr, size); } \
+    static forceinline void name##_free(void *ptr) { (free_fn)(ptr); }
+
+#endif
+
+/* Allocate 'count' blocks of 'size' bytes into 'out'; returns how many succeeded. */
+static inline size_t cdecl ator_malloc_batch(ator_t *ator, size_t size, size_t count, void **out) {
+    size_t i;
+    if (ator && ator != ATOR_ALIGNED && ator != ATOR_HUGE && ator->f_malloc_batch_ex)
+        return ator->f_malloc_batch_ex(ator, size, count, out);
+    for (i = 0; i < count; i ++) {
+        if (!((out[i] = ator_malloc(ator, size)))) break;
+    }
+    return i;
+}
+
+static inline void cdecl ator_free_batch(ator_t *ator, void **ptrs, size_t count) {
+    size_t i;
+    if (ator && ator != ATOR_ALIGNED && ator != ATOR_HUGE && ator->f_free_batch_ex) {
+        ator->f_free_batch_ex(ator, ptrs, count);
+        return;
+    }
+    for (i = 0; i < count; i ++) ator_free(ator, ptrs[i]);
+}
+
+/*
+ * Trimming.
+ *
+ * Backends that keep freed memory around (arenas and pools) can hand the
+ * pages of idle chunks and slabs back to the OS while keeping the address
+ * range, so reusing them later costs page faults rather than calls into the
+ * parent allocator. Define NOCL_ALLOCATOR_TRIM_LAZY to release pages with
+ * MADV_FREE, which is cheaper but only takes effect under memory pressure.
+ */
+
+/* Bytes in the whole pages inside 'size' bytes at 'ptr', which is all that can be released. */
+static inline size_t cdecl __nocl_internal_allocator_releasable(void *ptr, size_t size) {
+
+#if defined(__NOCL_INTERNAL_ALLOCATOR_HAS_MMAP) && defined(MADV_DONTNEED)
+
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t start = __nocl_internal_allocator_align_up((size_t) ptr, page);
+    size_t end = ((size_t) ptr + size) & ~(page - 1);
+
+    return end > start ? end - start : 0;
+
+#else
+
+    (void) ptr;
+    (void) size;
+    return 0;
+
+#endif
+
+}
+
+/* Give the whole pages inside 'size' bytes at 'ptr' back to the OS; returns the bytes released. */
+static inline size_t cdecl __nocl_internal_allocator_release(void *ptr, size_t size) {
+
+#if defined(__NOCL_INTERNAL_ALLOCATOR_HAS_MMAP) && defined(MADV_DONTNEED)
+
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t start = __nocl_internal_allocator_align_up((size_t) ptr, page);
+    size_t end = ((size_t) ptr + size) & ~(page - 1);
+
+    if (end <= start) return 0;
+
+#if defined(NOCL_ALLOCATOR_TRIM_LAZY) && defined(MADV_FREE)
+
+    if (!madvise((void *) start, end - start, MADV_FREE)) return end - start;
+
+#endif
+
+    return madvise((void *) start, end - start, MADV_DONTNEED) ? 0 : end - start;
+
+#else
+
+    (void) ptr;
+    (void) size;
+    return 0;
+
+#endif
+
+}
+
+/* Release retained memory until at most 'target_bytes' remain; returns the bytes released. */
+static inline size_t cdecl ator_trim(ator_t *ator, size_t target_bytes) {
+    if (!ator || ator == ATOR_ALIGNED || ator == ATOR_HUGE || !ator->f_trim_ex) return 0;
+    return ator->f_trim_ex(ator, target_bytes, NULL);
+}
+
+static inline void cdecl ator_trim_stats(ator_t *ator, ator_trim_stats_t *out) {
+    memset(out, 0, sizeof(ator_trim_stats_t));
+    if (!ator || ator == ATOR_ALIGNED || ator == ATOR_HUGE || !ator->f_trim_ex) return;
+    ator->f_trim_ex(ator, (size_t) -1, out);
+}
+
+/*
+ * Background trimming: a thread calls 'ator_trim(ator, budget_bytes)' every
+ * 'interval_ms' milliseconds until stopped. Only for allocators that may be
+ * trimmed from another thread, such as pools; arenas must be trimmed by
+ * their own thread.
+ */
+
+#if defined(NOCL_FEATURE_NO_THREADS)
+
+#define NOCL_FEATURE_NO_ALLOCATOR_TRIMMER
+
+#else
+
+typedef struct ator_trimmer_t {
+    ator_t *ator;
+    size_t budget;
+    unsigned long interval_ms;
+    int stop;
+    mtx_t lock;
+    cnd_t cond;
+    thrd_t thread;
+} ator_trimmer_t;
+
+static inline int cdecl __nocl_internal_allocator_trimmer_main(void *arg) {
+    ator_trimmer_t *trimmer = arg;
+    struct timespec deadline;
+
+    mtx_lock(&trimmer->lock);
+    while (!trimmer->stop) {
+        timespec_get(&deadline, TIME_UTC);
+        deadline.tv_sec += (time_t) (trimmer->interval_ms / 1000);
+        deadline.tv_nsec += (long) (trimmer->interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec ++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        if (cnd_timedwait(&trimmer->cond, &trimmer->lock, &deadline) != thrd_timedout) continue;
+
+        mtx_unlock(&trimmer->lock);
+        ator_trim(trimmer->ator, trimmer->budget);
+        mtx_lock(&trimmer->lock);
+    }
+    mtx_unlock(&trimmer->lock);
+
+    return 0;
+}
+
+static inline ator_trimmer_t *cdecl ator_trimmer_start(ator_t *ator, size_t budget_bytes, unsigned long interval_ms) {
+    ator_trimmer_t *trimmer = malloc(sizeof(ator_trimmer_t));
+    if (!trimmer) return NULL;
+
+    trimmer->ator = ator;
+    trimmer->budget = budget_bytes;
+    trimmer->interval_ms = interval_ms ? interval_ms : 1;
+    trimmer->stop = 0;
+
+    if (mtx_init(&trimmer->lock, mtx_plain) != thrd_success) {
+        free(trimmer);
+        return NULL;
+    }
+    if (cnd_init(&trimmer->cond) != thrd_success) {
+        mtx_destroy(&trimmer->lock);
+        free(trimmer);
+        return NULL;
+    }
+    if (thrd_create(&trimmer->thread, __nocl_internal_allocator_trimmer_main, trimmer) != thrd_success) {
+        cnd_destroy(&trimmer->cond);
+        mtx_destroy(&trimmer->lock);
+        free(trimmer);
+        return NULL;
+    }
+
+    return trimmer;
+}
+
+/* Stop the thread and wait for a trim in progress to finish. */
+static inline void cdecl ator_trimmer_stop(ator_trimmer_t *trimmer) {
+    if (!trimmer) return;
+
+    mtx_lock(&trimmer->lock);
+    trimmer->stop = 1;
+    cnd_signal(&trimmer->cond);
+    mtx_unlock(&trimmer->lock);
+
+    thrd_join(trimmer->thread, NULL);
+    cnd_destroy(&trimmer->cond);
+    mtx_destroy(&trimmer->lock);
+    free(trimmer);
+}
+
+#endif
+
+/*
+ * Arena (bump-pointer) backend.
+ *
+ * Memory is carved from chunks obtained from the parent allocator, and
+ * 'ator_free' is a no-op: everything is released at once by rewinding to a
+ * mark, resetting, or destroying the arena. Released chunks are kept on a
+ * spare list and reused by later allocations; 'ator_trim' returns the pages
+ * of the least recently released ones to the OS.
+ */
+
+#define __NOCL_INTERNAL_ALLOCATOR_ARENA_CHUNK_SIZE  65536
+
+struct __nocl_internal_allocator_arena_chunk {
+    struct __nocl_internal_allocator_arena_chunk *prev;
+    size_t size;
+    size_t used;
+    size_t released;  /* Bytes given back to the OS while spare. */
+};
+
+#define __NOCL_INTERNAL_ALLOCATOR_ARENA_CHUNK_HEADER \
+    __nocl_internal_allocator_align_up(sizeof(struct __nocl_internal_allocator_arena_chunk), __NOCL_INTERNAL_ALLOCATOR_ALIGN)
+
+#define __nocl_internal_allocator_arena_chunk_data(chunk) \
+    ((unsigned char *) (chunk) + __NOCL_INTERNAL_ALLOCATOR_ARENA_CHUNK_HEADER)
+
+typedef struct __nocl_internal_allocator_arena {
+    ator_t base;
+    ator_t *parent;
+    size_t chunk_size;
+    struct __nocl_internal_allocator_arena_chunk *head;
+    struct __nocl_internal_allocator_arena_chunk *tail;
+    struct __nocl_internal_allocator_arena_chunk *spare;
+    void *last;
+    size_t trimmed;
+    size_t reused;
+} __nocl_internal_allocator_arena;
+
+typedef struct ator_arena_mark_t {
+    void *chunk;
+    size_t used;
+} ator_arena_mark_t;
+
+static inline struct __nocl_internal_allocator_arena_chunk *cdecl __nocl_internal_allocator_arena_grow(__nocl_internal_allocator_arena *arena, size_t size) {
+    struct __nocl_internal_allocator_arena_chunk *chunk, **link;
+
+    /* Reuse the most recent spare chunk that is large enough; smaller ones stay spare. */
+    for (link = &arena->spare; (chunk = *link); link = &chunk->prev) {
+        if (chunk->size >= size) {
+            *link = chunk->prev;
+            break;
+        }
+    }
+
+    if (!chunk) {
+        size_t n = size > arena->chunk_size ? size : arena->chunk_size;
+        if (n > (size_t) -1 - __NOCL_INTERNAL_ALLOCATOR_ARENA_CHUNK_HEADER) return NULL;
+        if (!((chunk = ator_malloc(arena->parent, n + __NOCL_INTERNAL_ALLOCATOR_ARENA_CHUNK_HEADER)))) return NULL;
+        chunk->size = n;
+        chunk->released = 0;
+    }
+
+    arena->reused += chunk->released;
+    chunk->released = 0;
+    chunk->used = 0;
+    chunk->prev = arena->head;
+    if (!arena->head) arena->tail = chunk;
+    arena->head = chunk;
+    return chunk;
+}
+
+static inline void *cdecl __nocl_internal_allocator_arena_malloc(ator_t *ator, size_t size) {
+    __nocl_internal_allocator_arena *arena = (__nocl_internal_allocator_arena *) ator;
+    struct __nocl_internal_allocator_arena_chunk *chunk = arena->head;
+
+    if (size > (size_t) -1 - __NOCL_INTERNAL_ALLOCATOR_ALIGN) return NULL;
+    size = __nocl_internal_allocator_align_up(size ? size : 1, __NOCL_INTERNAL_ALLOCATOR_ALIGN);
+
+    if (!chunk || chunk->size - chunk->used < size) {
+        if (!((chunk = __nocl_internal_allocator_arena_grow(arena, size)))) return NULL;
+    }
+
+    void *res = __nocl_internal_allocator_arena_chunk_data(chunk) + chunk->used;
+    chunk->used += size;
+    arena->last = res;
+    return res;
+}
+
+static inline void *cdecl __nocl_internal_allocator_arena_calloc(ator_t *ator, size_t num, size_t size) {
+    if (size && num > (size_t) -1 / size) return NULL;
+    void *res = __nocl_internal_allocator_arena_malloc(ator, num * size);
+    if (res) memset(res, 0, num * size);
+    return res;
+}
+
+static inline void *cdecl __nocl_internal_allocator_arena_realloc(ator_t *ator, void *ptr, size_t size) {
+    __nocl_internal_allocator_arena *arena = (__nocl_internal_allocator_arena *) ator;
+    struct __nocl_internal_allocator_arena_chunk *chunk = arena->head;
+
+    if (!ptr) return __nocl_internal_allocator_arena_malloc(ator, size);
+    if (size > (size_t) -1 - __NOCL_INTERNAL_ALLOCATOR_ALIGN) return NULL;
+
+    /* The most recent allocation can be resized in place. */
+    if (ptr == arena->last) {
+        size_t offset = (size_t) ((unsigned char *) ptr - __nocl_internal_allocator_arena_chunk_data(chunk));
+        size_t n = __nocl_internal_allocator_align_up(size ? size : 1, __NOCL_INTERNAL_ALLOCATOR_ALIGN);
+        if (n <= chunk->size - offset) {
+            chunk->used = offset + n;
+            return ptr;
+        }
+    }
+    else {
+        for (; chunk; chunk = chunk->prev) {
+            unsigned char *data = __nocl_internal_allocator_arena_chunk_data(chunk);
+            if ((unsigned char *) ptr >= data && (unsigned char *) ptr < data + chunk->used) break;
+        }
+        if (!chunk) return NULL;
+    }
+
+    /* The old size is unknown; copying up to the end of the chunk's used area is always safe. */
+    size_t avail = chunk->used - (size_t) ((unsigned char *) ptr - __nocl_internal_allocator_arena_chunk_data(chunk));
+
+    void *res = __nocl_internal_allocator_arena_malloc(ator, size);
+    if (!res) return NULL;
+    memcpy(res, ptr, avail < size ? avail : size);
+    return res;
+}
+
+static inline void cdecl __nocl_internal_allocator_arena_free(ator_t *ator, void *ptr) {
+    (void) ator;
+    (void) ptr;
+}
+
+/* Carve all blocks from one contiguous run. */
+static inline size_t cdecl __nocl_internal_allocator_arena_malloc_batch(ator_t *ator, size_t size, size_t count, void **out) {
+    __nocl_internal_allocator_arena *arena = (__nocl_internal_allocator_arena *) ator;
+    struct __nocl_internal_allocator_arena_chunk *chunk = arena->head;
+    size_t i;
+
+    if (!count) return 0;
+    if (size > (size_t) -1 - __NOCL_INTERNAL_ALLOCATOR_ALIGN) return 0;
+    size = __nocl_internal_allocator_align_up(size ? size : 1, __NOCL_INTERNAL_ALLOCATOR_ALIGN);
+    if (count > (size_t) -1 / size) return 0;
+
+    if (!chunk || chunk->size - chunk->used < size * count) {
+        if (!((chunk = __nocl_internal_allocator_arena_grow(arena, size * count)))) return 0;
+    }
+
+    unsigned char *block = __nocl_internal_allocator_arena_chunk_data(chunk) + chunk->used;
+    for (i = 0; i < count; i ++, block += size) out[i] = block;
+    chunk->used += size * count;
+    arena->last = out[count - 1];
+    return count;
+}
+
+static inline void cdecl __nocl_internal_allocator_arena_free_batch(ator_t *ator, void **ptrs, size_t count) {
+    (void) ator;
+    (void) ptrs;
+    (void) count;
+}
+
+static inline void cdecl __nocl_internal_allocator_arena_destroy(ator_t *ator) {
+    __nocl_internal_allocator_arena *arena = (__nocl_internal_allocator_arena *) ator;
+    struct __nocl_internal_allocator_arena_chunk *chunk, *prev;
+
+    for (chunk = arena->head; chunk; chunk = prev) {
+        prev = chunk->prev;
+        ator_free(arena->parent, chunk);
+    }
+    for (chunk = arena->spare; chunk; chunk = prev) {
+        prev = chunk->prev;
+        ator_free(arena->parent, chunk);
+    }
+
+    ator_free(arena->parent, arena);
+}
+
+/* Keep the most recently released spare chunks up to 'target' bytes resident. */
+static inline size_t cdecl __nocl_internal_allocator_arena_trim(ator_t *ator, size_t target, ator_trim_stats_t *stats) {
+    __nocl_internal_allocator_arena *arena = (__nocl_internal_allocator_arena *) ator;
+    struct __nocl_internal_allocator_arena_chunk *chunk;
+    size_t kept = 0, res = 0;
+
+    for (chunk = arena->spare; chunk; chunk = chunk->prev) {
+        if (!chunk->released && kept + chunk->size > target) {
+            chunk->released = __nocl_internal_allocator_release(__nocl_internal_allocator_arena_chunk_data(chunk), chunk->size);
+            res += chunk->released;
+        }
+        kept += chunk->size - chunk->released;
+    }
+    arena->trimmed += res;
+
+    if (stats) {
+        stats->retained = kept;
+        stats->trimmed = arena->trimmed;
+        stats->reused = arena->reused;
+    }
+    return res;
+}
+
+/* Create an arena drawing 'chunk_size' byte chunks (0 for the default) from 'parent'. */
+static inline ator_t *cdecl ator_create_arena(size_t chunk_size, ator_t *parent) {
+    __nocl_internal_allocator_arena *arena = ator_malloc(parent, sizeof(__nocl_internal_allocator_arena));
+    if (!arena) return NULL;
+
+    arena->base.f_malloc  = NULL;
+    arena->base.f_calloc  = NULL;
+    arena->base.f_realloc = NULL;
+    arena->base.f_free    = NULL;
+
+    arena->base.f_malloc_ex  = __nocl_internal_allocator_arena_malloc;
+    arena->base.f_calloc_ex  = __nocl_internal_allocator_arena_calloc;
+    arena->base.f_realloc_ex = __nocl_internal_allocator_arena_realloc;
+    arena->base.f_free_ex    = __nocl_internal_allocator_arena_free;
+    arena->base.f_destroy_ex = __nocl_internal_allocator_arena_destroy;
+
+    arena->base.f_malloc_batch_ex = __nocl_internal_allocator_arena_malloc_batch;
+    arena->base.f_free_batch_ex   = __nocl_internal_allocator_arena_free_batch;
+
+    arena->base.f_trim_ex = __nocl_internal_allocator_arena_trim;
+
+    arena->parent = parent;
+    arena->chunk_size = chunk_size ? chunk_size : __NOCL_INTERNAL_ALLOCATOR_ARENA_CHUNK_SIZE;
+    arena->head = NULL;
+    arena->tail = NULL;
+    arena->spare = NULL;
+    arena->last = NULL;
+    arena->trimmed = 0;
+    arena->reused = 0;
+
+    return &arena->base;
+}
+
+static inline ator_arena_mark_t cdecl ator_arena_mark(ator_t *ator) {
+    __nocl_internal_allocator_arena *arena = (__nocl_internal_allocator_arena *) ator;
+    ator_arena_mark_t mark;
+    mark.chunk = arena->head;
+    mark.used = arena->head ? arena->head->used : 0;
+    return mark;
+}
+
+/* Release everything allocated since 'mark' was taken. */
+static inline void cdecl ator_arena_rewind(ator_t *ator, ator_arena_mark_t mark) {
+    __nocl_internal_allocator_arena *arena = (__nocl_internal_allocator_arena *) ator;
+    struct __nocl_internal_allocator_arena_chunk *chunk;
+
+    while ((chunk = arena->head) && chunk != mark.chunk) {
+        arena->head = chunk->prev;
+        chunk->prev = arena->spare;
+        arena->spare = chunk;
+    }
+
+    if (chunk) chunk->used = mark.used;
+    else arena->tail = NULL;
+    arena->last = NULL;
+}
+
+/* Release everything in O(1); the chunks are kept for reuse. */
+static inline void cdecl ator_arena_reset(ator_t *ator) {
+    __nocl_internal_allocator_arena *arena = (__nocl_internal_allocator_arena *) ator;
+
+    if (!arena->head) return;
+    arena->tail->prev = arena->spare;
+    arena->spare = arena->head;
+    arena->head = NULL;
+    arena->tail = NULL;
+    arena->last = NULL;
+}
+
+/*
+ * Per-thread scratch space for short-lived temporaries.
+ *
+ * Each thread lazily gets an arena; 'ator_scratch_begin' marks it and
+ * 'ator_scratch_end' rewinds to the mark, so scopes nest LIFO and their
+ * chunks stay warm for the next scope. Requests that do not fit spill into
+ * new chunks from the default allocator. The arena is destroyed when the
+ * thread exits.
+ */
+
+#if defined(NOCL_FEATURE_NO_THREADS)
+
+#define NOCL_FEATURE_NO_ALLOCATOR_SCRATCH
+
+#else
+
+#if !defined(NOCL_ALLOCATOR_SCRATCH_SIZE)
+
+#define NOCL_ALLOCATOR_SCRATCH_SIZE  65536
+
+#endif
+
+/* 'ator' is NULL if the scratch arena could not be created. */
+typedef struct ator_scratch_t {
+    ator_t *ator;
+    ator_arena_mark_t mark;
+} ator_scratch_t;
+
+/* The key only exists to destroy each thread's arena when the thread exits. */
+struct __nocl_internal_allocator_scratch_key {
+    once_flag once;
+    int created;
+    tss_t key;
+};
+
+_Selectany thread_local ator_t *__nocl_internal_allocator_scratch = NULL;
+_Selectany struct __nocl_internal_allocator_scratch_key __nocl_internal_allocator_scratch_key = { ONCE_FLAG_INIT, 0, 0 };
+
+static inline void cdecl __nocl_internal_allocator_scratch_dtor(void *ptr) {
+    ator_destroy(ptr);
+}
+
+static inline void cdecl __nocl_internal_allocator_scratch_key_create(void) {
+    __nocl_internal_allocator_scratch_key.created =
+        tss_create(&__nocl_internal_allocator_scratch_key.key, __nocl_internal_allocator_scratch_dtor) == thrd_success;
+}
+
+static inline ator_scratch_t cdecl ator_scratch_begin(void) {
+    ator_scratch_t scope;
+    ator_t *arena = __nocl_internal_allocator_scratch;
+
+    if (!arena) {
+        call_once(&__nocl_internal_allocator_scratch_key.once, __nocl_internal_allocator_scratch_key_create);
+        if (__nocl_internal_allocator_scratch_key.created &&
+            ((arena = ator_create_arena(NOCL_ALLOCATOR_SCRATCH_SIZE, ATOR_DEFAULT)))) {
+            if (tss_set(__nocl_internal_allocator_scratch_key.key, arena) == thrd_success)
+                __nocl_internal_allocator_scratch = arena;
+            else {
+                ator_destroy(arena);
+                arena = NULL;
+            }
+        }
+    }
+
+    scope.ator = arena;
+    if (arena) scope.mark = ator_arena_mark(arena);
+    return scope;
+}
+
+/* Release everything allocated from 'scope', including nested scopes. */
+static inline void cdecl ator_scratch_end(ator_scratch_t scope) {
+    if (scope.ator) ator_arena_rewind(scope.ator, scope.mark);
+}
+
+#endif
+
+/*
+ * Pool (slab) backend for fixed-size objects.
+ *
+ * Slabs of 'objects_per_slab' objects are obtained from the parent allocator
+ * and never returned before the pool is destroyed. Each thread keeps a free
+ * list of its own; objects move between it and the shared depot in batches,
+ * so the lock is only taken once per batch.
+ *
+ * Every object records the thread cache that allocated it in a trailing
+ * word. Freeing it from another thread pushes it onto the owner's lock-free
+ * remote list, which the owner takes over in one exchange once its own list
+ * runs dry. Caches of exited threads are kept and handed to new threads.
+ *
+ * 'ator_trim' looks for slabs whose objects are all in the depot and gives
+ * their pages back to the OS; such slabs are carved again before asking the
+ * parent for more. Slabs too small to span a whole page are never trimmed,
+ * so pools meant to be trimmed want 'objects_per_slab' covering a few pages.
+ */
+
+#if defined(NOCL_FEATURE_NO_THREADS)
+
+#define NOCL_FEATURE_NO_ALLOCATOR_POOL
+
+#else
+
+#define __NOCL_INTERNAL_ALLOCATOR_POOL_SLAB_OBJECTS  64
+
+/* Values of 'orphaned' for a cache whose thread is exiting or has exited. */
+#define __NOCL_INTERNAL_ALLOCATOR_POOL_EXITING   1
+#define __NOCL_INTERNAL_ALLOCATOR_POOL_ORPHANED  2
+
+struct __nocl_internal_allocator_pool;
+
+struct __nocl_internal_allocator_pool_slab {
+    struct __nocl_internal_allocator_pool_slab *next;
+    size_t released;
+};
+
+#define __NOCL_INTERNAL_ALLOCATOR_POOL_SLAB_HEADER \
+    __nocl_internal_allocator_align_up(sizeof(struct __nocl_internal_allocator_pool_slab), __NOCL_INTERNAL_ALLOCATOR_ALIGN)
+
+struct __nocl_internal_allocator_pool_cache {
+    struct __nocl_internal_allocator_pool_cache *next;
+    struct __nocl_internal_allocator_pool_cache *prev;
+    struct __nocl_internal_allocator_pool *pool;
+    void *head;
+    size_t count;
+    atomic_uintptr_t remote;
+    atomic_int orphaned;
+};
+
+typedef struct __nocl_internal_allocator_pool {
+    ator_t base;
+    ator_t *parent;
+    size_t object_size;
+    size_t stride;
+    size_t objects_per_slab;
+    size_t batch;
+    tss_t key;
+    mtx_t lock;
+    void *depot;
+    size_t depot_count;
+    struct __nocl_internal_allocator_pool_slab *slabs;
+    struct __nocl_internal_allocator_pool_slab *idle;  /* Trimmed slabs. */
+    size_t slab_count;
+    size_t trimmed;
+    size_t reused;
+    struct __nocl_internal_allocator_pool_cache *caches;
+} __nocl_internal_allocator_pool;
+
+#define __nocl_internal_allocator_pool_next(obj)  (*(void **) (obj))
+#define __nocl_internal_allocator_pool_owner(pool,obj) \
+    (*(struct __nocl_internal_allocator_pool_cache **) ((unsigned char *) (obj) + (pool)->stride - sizeof(void *)))
+
+/* Precondition: 'pool->lock' held. */
+static inline int cdecl __nocl_internal_allocator_pool_carve(__nocl_internal_allocator_pool *pool) {
+    struct __nocl_internal_allocator_pool_slab *slab = pool->idle;
+
+    if (slab) {
+        pool->idle = slab->next;
+        pool->reused += slab->released;
+    }
+    else if (!((slab = ator_malloc(pool->parent, __NOCL_INTERNAL_ALLOCATOR_POOL_SLAB_HEADER + pool->stride * pool->objects_per_slab)))) {
+        return 0;
+    }
+
+    slab->released = 0;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->slab_count ++;
+
+    unsigned char *obj = (unsigned char *) slab + __NOCL_INTERNAL_ALLOCATOR_POOL_SLAB_HEADER;
+    size_t i;
+    for (i = 0; i < pool->objects_per_slab; i ++, obj += pool->stride) {
+        __nocl_internal_allocator_pool_next(obj) = pool->depot;
+        pool->depot = obj;
+    }
+    pool->depot_count += pool->objects_per_slab;
+    return 1;
+}
+
+/* Move up to 'count' objects from the front of the cache to the depot. */
+static inline void cdecl __nocl_internal_allocator_pool_flush(struct __nocl_internal_allocator_pool_cache *cache, size_t count) {
+    __nocl_internal_allocator_pool *pool = cache->pool;
+    void *first = cache->head, *last = first;
+    size_t n;
+
+    if (!first || !count) return;
+    for (n = 1; n < count && __nocl_internal_allocator_pool_next(last); n ++)
+        last = __nocl_internal_allocator_pool_next(last);
+    cache->head = __nocl_internal_allocator_pool_next(last);
+    cache->count -= n;
+
+    mtx_lock(&pool->lock);
+    __nocl_internal_allocator_pool_next(last) = pool->depot;
+    pool->depot = first;
+    pool->depot_count += n;
+    mtx_unlock(&pool->lock);
+}
+
+/* Take over everything other threads have freed to this cache. */
+static inline void cdecl __nocl_internal_allocator_pool_drain(struct __nocl_internal_allocator_pool_cache *cache) {
+    void *first = (void *) atomic_exchange_explicit(&cache->remote, (uintptr_t) 0, memory_order_acquire);
+    void *last = first;
+    size_t n;
+
+    if (!first) return;
+    for (n = 1; __nocl_internal_allocator_pool_next(last); n ++)
+        last = __nocl_internal_allocator_pool_next(last);
+
+    __nocl_internal_allocator_pool_next(last) = cache->head;
+    cache->head = first;
+    cache->count += n;
+}
+
+/* Return the chain 'first'..'last' of 'count' objects to their owner 'cache' from another thread. */
+static inline void cdecl __nocl_internal_allocator_pool_remote_free(struct __nocl_internal_allocator_pool_cache *cache, void *first, void *last, size_t count) {
+    __nocl_internal_allocator_pool *pool = cache->pool;
+
+    /* Nobody is going to drain an orphaned cache soon. */
+    if (atomic_load_explicit(&cache->orphaned, memory_order_acquire)) {
+        mtx_lock(&pool->lock);
+        __nocl_internal_allocator_pool_next(last) = pool->depot;
+        pool->depot = first;
+        pool->depot_count += count;
+        mtx_unlock(&pool->lock);
+        return;
+    }
+
+    uintptr_t head = atomic_load_explicit(&cache->remote, memory_order_relaxed);
+    do __nocl_internal_allocator_pool_next(last) = (void *) head;
+    while (!atomic_compare_exchange_weak_explicit(&cache->remote, &head, (uintptr_t) first, memory_order_release, memory_order_relaxed));
+}
+
+/*
+ * Runs on thread exit: hand the cached objects back to the depot and orphan
+ * the cache. Remote frees that still slip onto it are drained on adoption.
+ */
+static inline void cdecl __nocl_internal_allocator_pool_cache_dtor(void *ptr) {
+    struct __nocl_internal_allocator_pool_cache *cache = ptr;
+
+    atomic_store_explicit(&cache->orphaned, __NOCL_INTERNAL_ALLOCATOR_POOL_EXITING, memory_order_seq_cst);
+
+    __nocl_internal_allocator_pool_drain(cache);
+    __nocl_internal_allocator_pool_flush(cache, cache->count);
+
+    atomic_store_explicit(&cache->orphaned, __NOCL_INTERNAL_ALLOCATOR_POOL_ORPHANED, memory_order_release);
+}
+
+static inline struct __nocl_internal_allocator_pool_cache *cdecl __nocl_internal_allocator_pool_cache_get(__nocl_internal_allocator_pool *pool) {
+    struct __nocl_internal_allocator_pool_cache *cache = tss_get(pool->key);
+    if (cache) return cache;
+
+    /* Adopt a cache left behind by an exited thread; objects may still name it as their owner. */
+    mtx_lock(&pool->lock);
+    for (cache = pool->caches; cache; cache = cache->next)
+        if (atomic_load_explicit(&cache->orphaned, memory_order_acquire) == __NOCL_INTERNAL_ALLOCATOR_POOL_ORPHANED) break;
+    if (cache) atomic_store_explicit(&cache->orphaned, 0, memory_order_relaxed);
+    mtx_unlock(&pool->lock);
+
+    if (cache) {
+        if (tss_set(pool->key, cache) != thrd_success) {
+            atomic_store_explicit(&cache->orphaned, __NOCL_INTERNAL_ALLOCATOR_POOL_ORPHANED, memory_order_release);
+            return NULL;
+        }
+        __nocl_internal_allocator_pool_drain(cache);
+        return cache;
+    }
+
+    if (!((cache = ator_malloc(pool->parent, sizeof(struct __nocl_internal_allocator_pool_cache))))) return NULL;
+    cache->pool = pool;
+    cache->head = NULL;
+    cache->count = 0;
+    cache->prev = NULL;
+    atomic_store_explicit(&cache->remote, (uintptr_t) 0, memory_order_relaxed);
+    atomic_store_explicit(&cache->orphaned, 0, memory_order_relaxed);
+
+    if (tss_set(pool->key, cache) != thrd_success) {
+        ator_free(pool->parent, cache);
+        return NULL;
+    }
+
+    mtx_lock(&pool->lock);
+    cache->next = pool->caches;
+    if (pool->caches) pool->caches->prev = cache;
+    pool->caches = cache;
+    mtx_unlock(&pool->lock);
+
+    return cache;
+}
+
+static inline void *cdecl __nocl_internal_allocator_pool_malloc(ator_t *ator, size_t size) {
+    __nocl_internal_allocator_pool *pool = (__nocl_internal_allocator_pool *) ator;
+    struct __nocl_internal_allocator_pool_cache *cache;
+    void *res;
+
+    if (size > pool->object_size) return NULL;
+    if (!((cache = __nocl_internal_allocator_pool_cache_get(pool)))) return NULL;
+
+    if (!cache->head) __nocl_internal_allocator_pool_drain(cache);
+
+    if (!((res = cache->head))) {
+        mtx_lock(&pool->lock);
+        if (!pool->depot && !__nocl_internal_allocator_pool_carve(pool)) {
+            mtx_unlock(&pool->lock);
+            return NULL;
+        }
+
+        /* Take one batch; the first object is the result. */
+        void *last = res = pool->depot;
+        size_t n;
+        for (n = 1; n < pool->batch && __nocl_internal_allocator_pool_next(last); n ++)
+            last = __nocl_internal_allocator_pool_next(last);
+        pool->depot = __nocl_internal_allocator_pool_next(last);
+        pool->depot_count -= n;
+        mtx_unlock(&pool->lock);
+
+        __nocl_internal_allocator_pool_next(last) = NULL;
+        cache->count = n;
+    }
+
+    cache->head = __nocl_internal_allocator_pool_next(res);
+    cache->count --;
+    __nocl_internal_allocator_pool_owner(pool, res) = cache;
+    return res;
+}
+
+static inline void *cdecl __nocl_internal_allocator_pool_calloc(ator_t *ator, size_t num, size_t size) {
+    if (size && num > (size_t) -1 / size) return NULL;
+    void *res = __nocl_internal_allocator_pool_malloc(ator, num * size);
+    if (res) memset(res, 0, num * size);
+    return res;
+}
+
+static inline void *cdecl __nocl_internal_allocator_pool_realloc(ator_t *ator, void *ptr, size_t size) {
+    __nocl_internal_allocator_pool *pool = (__nocl_internal_allocator_pool *) ator;
+    if (!ptr) return __nocl_internal_allocator_pool_malloc(ator, size);
+    return size <= pool->object_size ? ptr : NULL;
+}
+
+static inline void cdecl __nocl_internal_allocator_pool_free(ator_t *ator, void *ptr) {
+    __nocl_internal_allocator_pool *pool = (__nocl_internal_allocator_pool *) ator;
+    struct __nocl_internal_allocator_pool_cache *cache;
+
+    if (!ptr) return;
+
+    cache = tss_get(pool->key);
+    if (cache != __nocl_internal_allocator_pool_owner(pool, ptr)) {
+        __nocl_internal_allocator_pool_remote_free(__nocl_internal_allocator_pool_owner(pool, ptr), ptr, ptr, 1);
+        return;
+    }
+
+    __nocl_internal_allocator_pool_next(ptr) = cache->head;
+    cache->head = ptr;
+    if (++ cache->count >= 2 * pool->batch)
+        __nocl_internal_allocator_pool_flush(cache, pool->batch);
+}
+
+/* Drain the thread's cache first, then take the rest under one lock. */
+static inline size_t cdecl __nocl_internal_allocator_pool_malloc_batch(ator_t *ator, size_t size, size_t count, void **out) {
+    __nocl_internal_allocator_pool *pool = (__nocl_internal_allocator_pool *) ator;
+    struct __nocl_internal_allocator_pool_cache *cache;
+    size_t n = 0;
+
+    size_t i;
+
+    if (size > pool->object_size) return 0;
+    if (!((cache = __nocl_internal_allocator_pool_cache_get(pool)))) return 0;
+
+    if (cache->count < count) __nocl_internal_allocator_pool_drain(cache);
+
+    for (; n < count && cache->head; n ++) {
+        out[n] = cache->head;
+        cache->head = __nocl_internal_allocator_pool_next(cache->head);
+        cache->count --;
+    }
+
+    if (n < count) {
+        mtx_lock(&pool->lock);
+        for (; n < count; n ++) {
+            if (!pool->depot && !__nocl_internal_allocator_pool_carve(pool)) break;
+            out[n] = pool->depot;
+            pool->depot = __nocl_internal_allocator_pool_next(pool->depot);
+            pool->depot_count --;
+        }
+        mtx_unlock(&pool->lock);
+    }
+
+    for (i = 0; i < n; i ++) __nocl_internal_allocator_pool_owner(pool, out[i]) = cache;
+    return n;
+}
+
+static inline void cdecl __nocl_internal_allocator_pool_free_batch(ator_t *ator, void **ptrs, size_t count) {
+    __nocl_internal_allocator_pool *pool = (__nocl_internal_allocator_pool *) ator;
+    struct __nocl_internal_allocator_pool_cache *cache = tss_get(pool->key), *owner;
+    size_t i, j, n;
+
+    for (i = 0; i < count; i = j) {
+        if (!ptrs[i]) {
+            j = i + 1;
+            continue;
+        }
+
+        /* Objects with the same owner in a row go back as one chain. */
+        owner = __nocl_internal_allocator_pool_owner(pool, ptrs[i]);
+        for (j = i + 1, n = 1; j < count && ptrs[j] && __nocl_internal_allocator_pool_owner(pool, ptrs[j]) == owner; j ++, n ++)
+            __nocl_internal_allocator_pool_next(ptrs[j - 1]) = ptrs[j];
+
+        if (owner != cache) {
+            __nocl_internal_allocator_pool_remote_free(owner, ptrs[i], ptrs[j - 1], n);
+            continue;
+        }
+
+        __nocl_internal_allocator_pool_next(ptrs[j - 1]) = cache->head;
+        cache->head = ptrs[i];
+        cache->count += n;
+    }
+
+    /* Keep one batch locally and return the rest in one go. */
+    if (cache && cache->count >= 2 * pool->batch)
+        __nocl_internal_allocator_pool_flush(cache, cache->count - pool->batch);
+}
+
+static inline void cdecl __nocl_internal_allocator_pool_destroy(ator_t *ator) {
+    __nocl_internal_allocator_pool *pool = (__nocl_internal_allocator_pool *) ator;
+    struct __nocl_internal_allocator_pool_slab *slab, *next_slab;
+    struct __nocl_internal_allocator_pool_cache *cache, *next_cache;
+
+    /* No destructor runs for this key once it is deleted. */
+    tss_delete(pool->key);
+
+    for (cache = pool->caches; cache; cache = next_cache) {
+        next_cache = cache->next;
+        ator_free(pool->parent, cache);
+    }
+    for (slab = pool->slabs; slab; slab = next_slab) {
+        next_slab = slab->next;
+        ator_free(pool->parent, slab);
+    }
+    for (slab = pool->idle; slab; slab = next_slab) {
+        next_slab = slab->next;
+        ator_free(pool->parent, slab);
+    }
+
+    mtx_destroy(&pool->lock);
+    ator_free(pool->parent, pool);
+}
+
+static inline int cdecl __nocl_internal_allocator_pool_slab_compare(const void *a, const void *b) {
+    size_t x = (size_t) *(void *const *) a, y = (size_t) *(void *const *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* Index of the slab in the sorted 'slabs' holding 'obj'. */
+static inline size_t cdecl __nocl_internal_allocator_pool_slab_find(struct __nocl_internal_allocator_pool_slab **slabs, size_t count, void *obj) {
+    size_t lo = 0, hi = count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ((size_t) slabs[mid] <= (size_t) obj) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Trim fully free slabs, lowest addresses first, until the depot holds at most 'target' bytes. */
+static inline size_t cdecl __nocl_internal_allocator_pool_trim(ator_t *ator, size_t target, ator_trim_stats_t *stats) {
+    __nocl_internal_allocator_pool *pool = (__nocl_internal_allocator_pool *) ator;
+    struct __nocl_internal_allocator_pool_slab **slabs = NULL, *slab;
+    size_t *counts = NULL, n, i, res = 0;
+    size_t slab_bytes = pool->stride * pool->objects_per_slab;
+    void *obj, **link;
+
+    mtx_lock(&pool->lock);
+
+    size_t retained = pool->depot_count * pool->stride;
+    if (retained <= target || !((n = pool->slab_count))) goto done;
+
+    if (!((slabs = malloc(n * sizeof(*slabs)))) || !((counts = calloc(n, sizeof(size_t))))) goto done;
+    for (slab = pool->slabs, i = 0; slab; slab = slab->next) slabs[i ++] = slab;
+    qsort(slabs, n, sizeof(*slabs), __nocl_internal_allocator_pool_slab_compare);
+
+    for (obj = pool->depot; obj; obj = __nocl_internal_allocator_pool_next(obj))
+        counts[__nocl_internal_allocator_pool_slab_find(slabs, n, obj)] ++;
+
+    /*
+     * Mark the slabs to release with an impossible count. A slab that spans
+     * no whole page would give nothing back, so it stays in use.
+     */
+    for (i = 0; i < n && retained > target; i ++) {
+        if (counts[i] != pool->objects_per_slab ||
+            !__nocl_internal_allocator_releasable((unsigned char *) slabs[i] + __NOCL_INTERNAL_ALLOCATOR_POOL_SLAB_HEADER, slab_bytes)) continue;
+        counts[i] = (size_t) -1;
+        retained -= slab_bytes;
+    }
+
+    for (link = &pool->depot; *link; ) {
+        if (counts[__nocl_internal_allocator_pool_slab_find(slabs, n, *link)] == (size_t) -1) {
+            *link = __nocl_internal_allocator_pool_next(*link);
+            pool->depot_count --;
+        }
+        else link = &__nocl_internal_allocator_pool_next(*link);
+    }
+
+    pool->slabs = NULL;
+    for (i = 0; i < n; i ++) {
+        slab = slabs[i];
+        if (counts[i] != (size_t) -1) {
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+            continue;
+        }
+
+        slab->released = __nocl_internal_allocator_release((unsigned char *) slab + __NOCL_INTERNAL_ALLOCATOR_POOL_SLAB_HEADER, slab_bytes);
+        if (!slab->released) {
+            /* madvise refused; nothing was given back, so put the objects back in the depot. */
+            unsigned char *obj = (unsigned char *) slab + __NOCL_INTERNAL_ALLOCATOR_POOL_SLAB_HEADER;
+            size_t j;
+            for (j = 0; j < pool->objects_per_slab; j ++, obj += pool->stride) {
+                __nocl_internal_allocator_pool_next(obj) = pool->depot;
+                pool->depot = obj;
+            }
+            pool->depot_count += pool->objects_per_slab;
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+            continue;
+        }
+
+        res += slab->released;
+        slab->next = pool->idle;
+        pool->idle = slab;
+        pool->slab_count --;
+    }
+    pool->trimmed += res;
+
+done:
+    if (stats) {
+        /* Like arenas, count what is still resident: the depot and the unreleased rest of trimmed slabs. */
+        stats->retained = pool->depot_count * pool->stride;
+        for (slab = pool->idle; slab; slab = slab->next) stats->retained += slab_bytes - slab->released;
+        stats->trimmed = pool->trimmed;
+        stats->reused = pool->reused;
+    }
+    mtx_unlock(&pool->lock);
+
+    free(slabs);
+    free(counts);
+    return res;
+}
+
+/*
+ * Create a pool of 'object_size' byte objects, allocated 'objects_per_slab'
+ * (0 for the default) at a time from 'parent'.
+ */
+static inline ator_t *cdecl ator_create_pool(size_t object_size, size_t objects_per_slab, ator_t *parent) {
+    if (object_size < sizeof(void *)) object_size = sizeof(void *);
+    if (object_size > (size_t) -1 - __NOCL_INTERNAL_ALLOCATOR_ALIGN) return NULL;
+    object_size = __nocl_internal_allocator_align_up(object_size, __NOCL_INTERNAL_ALLOCATOR_ALIGN);
+    size_t stride = __nocl_internal_allocator_align_up(object_size + sizeof(void *), __NOCL_INTERNAL_ALLOCATOR_ALIGN);
+    if (stride < object_size) return NULL;
+    if (!objects_per_slab) objects_per_slab = __NOCL_INTERNAL_ALLOCATOR_POOL_SLAB_OBJECTS;
+    if (objects_per_slab > ((size_t) -1 - __NOCL_INTERNAL_ALLOCATOR_POOL_SLAB_HEADER) / stride) return NULL;
+
+    __nocl_internal_allocator_pool *pool = ator_malloc(parent, sizeof(__nocl_internal_allocator_pool));
+    if (!pool) return NULL;
+
+    if (tss_create(&pool->key, __nocl_internal_allocator_pool_cache_dtor) != thrd_success) {
+        ator_free(parent, pool);
+        return NULL;
+    }
+    if (mtx_init(&pool->lock, mtx_plain) != thrd_success) {
+        tss_delete(pool->key);
+        ator_free(parent, pool);
+        return NULL;
+    }
+
+    pool->base.f_malloc  = NULL;
+    pool->base.f_calloc  = NULL;
+    pool->base.f_realloc = NULL;
+    pool->base.f_free    = NULL;
+
+    pool->base.f_malloc_ex  = __nocl_internal_allocator_pool_malloc;
+    pool->base.f_calloc_ex  = __nocl_internal_allocator_pool_calloc;
+    pool->base.f_realloc_ex = __nocl_internal_allocator_pool_realloc;
+    pool->base.f_free_ex    = __nocl_internal_allocator_pool_free;
+    pool->base.f_destroy_ex = __nocl_internal_allocator_pool_destroy;
+
+    pool->base.f_malloc_batch_ex = __nocl_internal_allocator_pool_malloc_batch;
+    pool->base.f_free_batch_ex   = __nocl_internal_allocator_pool_free_batch;
+
+    pool->base.f_trim_ex = __nocl_internal_allocator_pool_trim;
+
+    pool->parent = parent;
+    pool->object_size = object_size;
+    pool->stride = stride;
+    pool->objects_per_slab = objects_per_slab;
+    pool->batch = objects_per_slab;
+    pool->depot = NULL;
+    pool->depot_count = 0;
+    pool->slabs = NULL;
+    pool->idle = NULL;
+    pool->slab_count = 0;
+    pool->trimmed = 0;
+    pool->reused = 0;
+    pool->caches = NULL;
+
+    return &pool->base;
+}
+
+#endif
+
+/*
+ * Object cache with constructor/destructor.
+ *
+ * Objects are constructed once, when their slab is obtained from the
+ * backend, and stay constructed while they cycle between callers: freeing
+ * an object only returns it to the cache. Destructors run when the slabs
+ * are released, so every object must have been freed by then.
+ *
+ * Each thread holds a loaded and a previous magazine of objects and only
+ * visits the shared depot of full and empty magazines, under its lock, when
+ * both are exhausted (on allocation) or both are full (on free).
+ */
+
+#if defined(NOCL_FEATURE_NO_THREADS)
+
+#define NOCL_FEATURE_NO_ALLOCATOR_CACHE
+
+#else
+
+#define __NOCL_INTERNAL_ALLOCATOR_CACHE_MAGAZINE_SIZE  32
+#define __NOCL_INTERNAL_ALLOCATOR_CACHE_SLAB_BYTES     16384
+
+typedef int  (*ator_cache_ctor_t) (void *);  /* Returns 0 on success. */
+typedef void (*ator_cache_dtor_t) (void *);
+
+struct __nocl_internal_allocator_cache;
+
+struct __nocl_internal_allocator_cache_magazine {
+    struct __nocl_internal_allocator_cache_magazine *next;
+    size_t rounds;
+    void *objects[__NOCL_INTERNAL_ALLOCATOR_CACHE_MAGAZINE_SIZE];
+};
+
+struct __nocl_internal_allocator_cache_slab {
+    struct __nocl_internal_allocator_cache_slab *next;
+    unsigned char *objects;
+    size_t count;
+};
+
+struct __nocl_internal_allocator_cache_cpu {
+    struct __nocl_internal_allocator_cache_cpu *next;
+    struct __nocl_internal_allocator_cache_cpu *prev;
+    struct __nocl_internal_allocator_cache *cache;
+    struct __nocl_internal_allocator_cache_magazine *loaded;
+    struct __nocl_internal_allocator_cache_magazine *previous;
+};
+
+typedef struct __nocl_internal_allocator_cache {
+    ator_t base;
+    size_t object_size;
+    size_t align;
+    size_t objects_per_slab;
+    ator_cache_ctor_t ctor;
+    ator_cache_dtor_t dtor;
+    tss_t key;
+    mtx_t lock;
+    struct __nocl_internal_allocator_cache_magazine *full;
+    struct __nocl_internal_allocator_cache_magazine *empty;
+    struct __nocl_internal_allocator_cache_slab *slabs;
+    void *free_objects;
+    struct __nocl_internal_allocator_cache_cpu *cpus;
+} __nocl_internal_allocator_cache;
+
+/*
+ * Precondition: 'cache->lock' held.
+ * Objects are never chained through their own storage, since that would
+ * clobber their constructed state.
+ */
+static inline int cdecl __nocl_internal_allocator_cache_grow(__nocl_internal_allocator_cache *cache) {
+    struct __nocl_internal_allocator_cache_magazine *magazines = NULL, *magazine;
+    struct __nocl_internal_allocator_cache_slab *slab;
+    size_t i;
+
+    if (cache->objects_per_slab > (size_t) -1 / cache->object_size) return 0;
+
+    /* Reserve every magazine the slab needs first, so no object is ever left without one. */
+    for (i = 0; i < cache->objects_per_slab; i += __NOCL_INTERNAL_ALLOCATOR_CACHE_MAGAZINE_SIZE) {
+        if ((magazine = cache->empty)) cache->empty = magazine->next;
+        else if (!((magazine = malloc(sizeof(struct __nocl_internal_allocator_cache_magazine))))) goto fail;
+        magazine->next = magazines;
+        magazines = magazine;
+    }
+
+    if (!((slab = malloc(sizeof(struct __nocl_internal_allocator_cache_slab))))) goto fail;
+
+    if (!((slab->objects = aligned_malloc_large(cache->object_size * cache->objects_per_slab, cache->align, ALIGNED_LARGE_DEFAULT)))) {
+        free(slab);
+        goto fail;
+    }
+    slab->count = cache->objects_per_slab;
+
+    if (cache->ctor) {
+        for (i = 0; i < slab->count; i ++) {
+            if (cache->ctor(slab->objects + i * cache->object_size)) {
+                while (i --) if (cache->dtor) cache->dtor(slab->objects + i * cache->object_size);
+                aligned_free_large(slab->objects);
+                free(slab);
+                goto fail;
+            }
+        }
+    }
+
+    slab->next = cache->slabs;
+    cache->slabs = slab;
+
+    /* Hand the new objects out through a full magazine per batch. */
+    for (i = 0; i < slab->count; ) {
+        magazine = magazines;
+        magazines = magazine->next;
+        for (magazine->rounds = 0; magazine->rounds < __NOCL_INTERNAL_ALLOCATOR_CACHE_MAGAZINE_SIZE && i < slab->count; i ++)
+            magazine->objects[magazine->rounds ++] = slab->objects + i * cache->object_size;
+        magazine->next = cache->full;
+        cache->full = magazine;
+    }
+
+    return 1;
+
+fail:
+    /* Park the reserved magazines in the depot for the next attempt. */
+    while ((magazine = magazines)) {
+        magazines = magazine->next;
+        magazine->next = cache->empty;
+        cache->empty = magazine;
+    }
+    return 0;
+}
+
+/* Runs on thread exit: hand the magazines back to the depot. */
+static inline void cdecl __nocl_internal_allocator_cache_cpu_dtor(void *ptr) {
+    struct __nocl_internal_allocator_cache_cpu *cpu = ptr;
+    __nocl_internal_allocator_cache *cache = cpu->cache;
+    struct __nocl_internal_allocator_cache_magazine *magazines[2];
+    size_t i;
+
+    magazines[0] = cpu->loaded;
+    magazines[1] = cpu->previous;
+
+    mtx_lock(&cache->lock);
+    for (i = 0; i < 2; i ++) {
+        if (!magazines[i]) continue;
+        if (magazines[i]->rounds) {
+            magazines[i]->next = cache->full;
+            cache->full = magazines[i];
+        }
+        else {
+            magazines[i]->next = cache->empty;
+            cache->empty = magazines[i];
+        }
+    }
+    if (cpu->prev) cpu->prev->next = cpu->next;
+    else cache->cpus = cpu->next;
+    if (cpu->next) cpu->next->prev = cpu->prev;
+    mtx_unlock(&cache->lock);
+
+    free(cpu);
+}
+
+static inline struct __nocl_internal_allocator_cache_cpu *cdecl __nocl_internal_allocator_cache_cpu_get(__nocl_internal_allocator_cache *cache) {
+    struct __nocl_internal_allocator_cache_cpu *cpu = tss_get(cache->key);
+    if (cpu) return cpu;
+
+    if (!((cpu = calloc(1, sizeof(struct __nocl_internal_allocator_cache_cpu))))) return NULL;
+    cpu->cache = cache;
+
+    if (tss_set(cache->key, cpu) != thrd_success) {
+        free(cpu);
+        return NULL;
+    }
+
+    mtx_lock(&cache->lock);
+    cpu->next = cache->cpus;
+    if (cache->cpus) cache->cpus->prev = cpu;
+    cache->cpus = cpu;
+    mtx_unlock(&cache->lock);
+
+    return cpu;
+}
+
+static inline void *cdecl __nocl_internal_allocator_cache_malloc(ator_t *ator, size_t size) {
+    __nocl_internal_allocator_cache *cache = (__nocl_internal_allocator_cache *) ator;
+    struct __nocl_internal_allocator_cache_cpu *cpu;
+    struct __nocl_internal_allocator_cache_magazine *magazine;
+
+    if (size > cache->object_size) return NULL;
+    if (!((cpu = __nocl_internal_allocator_cache_cpu_get(cache)))) return NULL;
+
+    if (cpu->loaded && cpu->loaded->rounds) return cpu->loaded->objects[-- cpu->loaded->rounds];
+
+    if (cpu->previous && cpu->previous->rounds) {
+        magazine = cpu->loaded;
+        cpu->loaded = cpu->previous;
+        cpu->previous = magazine;
+        return cpu->loaded->objects[-- cpu->loaded->rounds];
+    }
+
+    mtx_lock(&cache->lock);
+
+    if (!cache->full && cache->free_objects) {
+        void **link = cache->free_objects;
+        void *res = link[1];
+        cache->free_objects = link[0];
+        mtx_unlock(&cache->lock);
+        free(link);
+        return res;
+    }
+
+    if (!cache->full && !__nocl_internal_allocator_cache_grow(cache)) {
+        mtx_unlock(&cache->lock);
+        return NULL;
+    }
+
+    /* Trade the empty previous magazine for a full one from the depot. */
+    if (cpu->previous) {
+        cpu->previous->next = cache->empty;
+        cache->empty = cpu->previous;
+    }
+    cpu->previous = cpu->loaded;
+    cpu->loaded = cache->full;
+    cache->full = cpu->loaded->next;
+
+    mtx_unlock(&cache->lock);
+
+    return cpu->loaded->objects[-- cpu->loaded->rounds];
+}
+
+static inline void cdecl __nocl_internal_allocator_cache_free(ator_t *ator, void *ptr) {
+    __nocl_internal_allocator_cache *cache = (__nocl_internal_allocator_cache *) ator;
+    struct __nocl_internal_allocator_cache_cpu *cpu;
+    struct __nocl_internal_allocator_cache_magazine *magazine = NULL;
+
+    if (!ptr) return;
+
+    if ((cpu = __nocl_internal_allocator_cache_cpu_get(cache))) {
+        if (cpu->loaded && cpu->loaded->rounds < __NOCL_INTERNAL_ALLOCATOR_CACHE_MAGAZINE_SIZE) {
+            cpu->loaded->objects[cpu->loaded->rounds ++] = ptr;
+            return;
+        }
+
+        if (cpu->previous && !cpu->previous->rounds) {
+            magazine = cpu->loaded;
+            cpu->loaded = cpu->previous;
+            cpu->previous = magazine;
+            cpu->loaded->objects[cpu->loaded->rounds ++] = ptr;
+            return;
+        }
+    }
+
+    mtx_lock(&cache->lock);
+    if ((magazine = cache->empty)) cache->empty = magazine->next;
+    mtx_unlock(&cache->lock);
+
+    if (!magazine && ((magazine = malloc(sizeof(struct __nocl_internal_allocator_cache_magazine))))) magazine->rounds = 0;
+
+    if (!magazine || !cpu) {
+        /* No magazine to keep it in; fall back to the overflow list. */
+        void **link = malloc(2 * sizeof(void *));
+        mtx_lock(&cache->lock);
+        if (magazine) {
+            magazine->next = cache->empty;
+            cache->empty = magazine;
+        }
+        if (link) {
+            link[0] = cache->free_objects;
+            link[1] = ptr;
+            cache->free_objects = link;
+        }
+        mtx_unlock(&cache->lock);
+        return;
+    }
+
+    /* Retire the full previous magazine to the depot and load the empty one. */
+    if (cpu->previous) {
+        mtx_lock(&cache->lock);
+        cpu->previous->next = cache->full;
+        cache->full = cpu->previous;
+        mtx_unlock(&cache->lock);
+    }
+    cpu->previous = cpu->loaded;
+    cpu->loaded = magazine;
+    cpu->loaded->objects[cpu->loaded->rounds ++] = ptr;
+}
+
+/* Zeroing would destroy the constructed state, so this is only offered without a constructor. */
+static inline void *cdecl __nocl_internal_allocator_cache_calloc(ator_t *ator, size_t num, size_t size) {
+    __nocl_internal_allocator_cache *cache = (__nocl_internal_allocator_cache *) ator;
+    if (cache->ctor || (size && num > (size_t) -1 / size)) return NULL;
+    void *res = __nocl_internal_allocator_cache_malloc(ator, num * size);
+    if (res) memset(res, 0, num * size);
+    return res;
+}
+
+static inline void *cdecl __nocl_internal_allocator_cache_realloc(ator_t *ator, void *ptr, size_t size) {
+    __nocl_internal_allocator_cache *cache = (__nocl_internal_allocator_cache *) ator;
+    if (!ptr) return __nocl_internal_allocator_cache_malloc(ator, size);
+    return size <= cache->object_size ? ptr : NULL;
+}
+
+static inline void cdecl __nocl_internal_allocator_cache_destroy(ator_t *ator) {
+    __nocl_internal_allocator_cache *cache = (__nocl_internal_allocator_cache *) ator;
+    struct __nocl_internal_allocator_cache_magazine *magazine, *next_magazine;
+    struct __nocl_internal_allocator_cache_slab *slab, *next_slab;
+    struct __nocl_internal_allocator_cache_cpu *cpu, *next_cpu;
+    void **link, **next_link;
+    size_t i;
+
+    /* No destructor runs for this key once it is deleted. */
+    tss_delete(cache->key);
+
+    for (cpu = cache->cpus; cpu; cpu = next_cpu) {
+        next_cpu = cpu->next;
+        free(cpu->loaded);
+        free(cpu->previous);
+        free(cpu);
+    }
+    for (magazine = cache->full; magazine; magazine = next_magazine) {
+        next_magazine = magazine->next;
+        free(magazine);
+    }
+    for (magazine = cache->empty; magazine; magazine = next_magazine) {
+        next_magazine = magazine->next;
+        free(magazine);
+    }
+    for (link = cache->free_objects; link; link = next_link) {
+        next_link = link[0];
+        free(link);
+    }
+
+    for (slab = cache->slabs; slab; slab = next_slab) {
+        next_slab = slab->next;
+        if (cache->dtor) {
+            for (i = 0; i < slab->count; i ++) cache->dtor(slab->objects + i * cache->object_size);
+        }
+        aligned_free_large(slab->objects);
+        free(slab);
+    }
+
+    mtx_destroy(&cache->lock);
+    free(cache);
+}
+
+/*
+ * Create a cache of 'size' byte objects aligned to 'align' (0 for the
+ * default). 'ctor' and 'dtor' may be NULL.
+ */
+static inline ator_t *cdecl ator_cache_create(size_t size, size_t align, ator_cache_ctor_t ctor, ator_cache_dtor_t dtor) {
+    if (!align) align = __NOCL_INTERNAL_ALLOCATOR_ALIGN;
+    if (!size) size = 1;
+    if (size > (size_t) -1 - align) return NULL;
+    size = __nocl_internal_allocator_align_up(size, align);
+
+    __nocl_internal_allocator_cache *cache = malloc(sizeof(__nocl_internal_allocator_cache));
+    if (!cache) return NULL;
+
+    if (tss_create(&cache->key, __nocl_internal_allocator_cache_cpu_dtor) != thrd_success) {
+        free(cache);
+        return NULL;
+    }
+    if (mtx_init(&cache->lock, mtx_plain) != thrd_success) {
+        tss_delete(cache->key);
+        free(cache);
+        return NULL;
+    }
+
+    cache->base.f_malloc  = NULL;
+    cache->base.f_calloc  = NULL;
+    cache->base.f_realloc = NULL;
+    cache->base.f_free    = NULL;
+
+    cache->base.f_malloc_ex  = __nocl_internal_allocator_cache_malloc;
+    cache->base.f_calloc_ex  = __nocl_internal_allocator_cache_calloc;
+    cache->base.f_realloc_ex = __nocl_internal_allocator_cache_realloc;
+    cache->base.f_free_ex    = __nocl_internal_allocator_cache_free;
+    cache->base.f_destroy_ex = __nocl_internal_allocator_cache_destroy;
+
+    cache->base.f_malloc_batch_ex = NULL;
+    cache->base.f_free_batch_ex   = NULL;
+
+    cache->base.f_trim_ex = NULL;
+
+    cache->object_size = size;
+    cache->align = align;
+    cache->objects_per_slab = size < __NOCL_INTERNAL_ALLOCATOR_CACHE_SLAB_BYTES / 8 ? __NOCL_INTERNAL_ALLOCATOR_CACHE_SLAB_BYTES / size : 8;
+    cache->ctor = ctor;
+    cache->dtor = dtor;
+    cache->full = NULL;
+    cache->empty = NULL;
+    cache->slabs = NULL;
+    cache->free_objects = NULL;
+    cache->cpus = NULL;
+
+    return &cache->base;
+}
+
+#endif
+
+/*
+ * Thread-caching front end for any allocator.
+ *
+ * Blocks carry a small header holding their size class. Freed blocks stay in
+ * per-thread bins until the thread caches more than 'max_cached_bytes', at
+ * which point half of the bin is handed back to the backend in one go.
+ * Requests above the largest class go straight to the backend.
+ */
+
+#if defined(NOCL_FEATURE_NO_THREADS)
+
+#define NOCL_FEATURE_NO_ALLOCATOR_TCACHE
+
+#else
+
+#define __NOCL_INTERNAL_ALLOCATOR_TCACHE_MIN_SHIFT    4
+#define __NOCL_INTERNAL_ALLOCATOR_TCACHE_CLASSES      12
+#define __NOCL_INTERNAL_ALLOCATOR_TCACHE_NO_CLASS     ((size_t) -1)
+#define __NOCL_INTERNAL_ALLOCATOR_TCACHE_MAX_CACHED   262144
+
+#define __NOCL_INTERNAL_ALLOCATOR_TCACHE_HEADER  __NOCL_INTERNAL_ALLOCATOR_ALIGN
+
+#define __nocl_internal_allocator_tcache_class_size(cls) \
+    ((size_t) 1 << ((cls) + __NOCL_INTERNAL_ALLOCATOR_TCACHE_MIN_SHIFT))
+
+#define __nocl_internal_allocator_tcache_class_of(ptr) \
+    (*(size_t *) ((unsigned char *) (ptr) - __NOCL_INTERNAL_ALLOCATOR_TCACHE_HEADER))
+
+struct __nocl_internal_allocator_tcache;
+
+struct __nocl_internal_allocator_tcache_bin {
+    void *head;
+    size_t count;
+};
+
+struct __nocl_internal_allocator_tcache_cache {
+    struct __nocl_internal_allocator_tcache_cache *next;
+    struct __nocl_internal_allocator_tcache_cache *prev;
+    struct __nocl_internal_allocator_tcache *tcache;
+    size_t cached_bytes;
+    struct __nocl_internal_allocator_tcache_bin bins[__NOCL_INTERNAL_ALLOCATOR_TCACHE_CLASSES];
+};
+
+typedef struct __nocl_internal_allocator_tcache {
+    ator_t base;
+    ator_t *backend;
+    size_t max_cached_bytes;
+    tss_t key;
+    mtx_t lock;
+    struct __nocl_internal_allocator_tcache_cache *caches;
+} __nocl_internal_allocator_tcache;
+
+static inline size_t cdecl __nocl_internal_allocator_tcache_class(size_t size) {
+    size_t cls = 0;
+    while (cls < __NOCL_INTERNAL_ALLOCATOR_TCACHE_CLASSES && __nocl_internal_allocator_tcache_class_size(cls) < size) cls ++;
+    return cls < __NOCL_INTERNAL_ALLOCATOR_TCACHE_CLASSES ? cls : __NOCL_INTERNAL_ALLOCATOR_TCACHE_NO_CLASS;
+}
+
+#define __NOCL_INTERNAL_ALLOCATOR_TCACHE_FLUSH_BATCH  64
+
+/* Return up to 'count' blocks of a bin to the backend, a batch at a time. */
+static inline void cdecl __nocl_internal_allocator_tcache_flush(struct __nocl_internal_allocator_tcache_cache *cache, size_t cls, size_t count) {
+    struct __nocl_internal_allocator_tcache_bin *bin = &cache->bins[cls];
+    ator_t *backend = cache->tcache->backend;
+    void *blocks[__NOCL_INTERNAL_ALLOCATOR_TCACHE_FLUSH_BATCH];
+    void *block;
+    size_t n;
+
+    while (count && bin->head) {
+        for (n = 0; n < __NOCL_INTERNAL_ALLOCATOR_TCACHE_FLUSH_BATCH && count && ((block = bin->head)); n ++, count --) {
+            bin->head = *(void **) block;
+            blocks[n] = (unsigned char *) block - __NOCL_INTERNAL_ALLOCATOR_TCACHE_HEADER;
+        }
+        bin->count -= n;
+        cache->cached_bytes -= n * __nocl_internal_allocator_tcache_class_size(cls);
+        ator_free_batch(backend, blocks, n);
+    }
+}
+
+/* Runs on thread exit: release everything the thread has cached. */
+static inline void cdecl __nocl_internal_allocator_tcache_cache_dtor(void *ptr) {
+    struct __nocl_internal_allocator_tcache_cache *cache = ptr;
+    __nocl_internal_allocator_tcache *tcache = cache->tcache;
+    size_t cls;
+
+    for (cls = 0; cls < __NOCL_INTERNAL_ALLOCATOR_TCACHE_CLASSES; cls ++)
+        __nocl_internal_allocator_tcache_flush(cache, cls, cache->bins[cls].count);
+
+    mtx_lock(&tcache->lock);
+    if (cache->prev) cache->prev->next = cache->next;
+    else tcache->caches = cache->next;
+    if (cache->next) cache->next->prev = cache->prev;
+    mtx_unlock(&tcache->lock);
+
+    free(cache);
+}
+
+static inline struct __nocl_internal_allocator_tcache_cache *cdecl __nocl_internal_allocator_tcache_cache_get(__nocl_internal_allocator_tcache *tcache) {
+    struct __nocl_internal_allocator_tcache_cache *cache = tss_get(tcache->key);
+    if (cache) return cache;
+
+    if (!((cache = calloc(1, sizeof(struct __nocl_internal_allocator_tcache_cache))))) return NULL;
+    cache->tcache = tcache;
+
+    if (tss_set(tcache->key, cache) != thrd_success) {
+        free(cache);
+        return NULL;
+    }
+
+    mtx_lock(&tcache->lock);
+    cache->next = tcache->caches;
+    if (tcache->caches) tcache->caches->prev = cache;
+    tcache->caches = cache;
+    mtx_unlock(&tcache->lock);
+
+    return cache;
+}
+
+static inline void *cdecl __nocl_internal_allocator_tcache_malloc(ator_t *ator, size_t size) {
+    __nocl_internal_allocator_tcache *tcache = (__nocl_internal_allocator_tcache *) ator;
+    size_t cls = __nocl_internal_allocator_tcache_class(size);
+    unsigned char *block;
+
+    if (cls != __NOCL_INTERNAL_ALLOCATOR_TCACHE_NO_CLASS) {
+        struct __nocl_internal_allocator_tcache_cache *cache = __nocl_internal_allocator_tcache_cache_get(tcache);
+        if (cache && ((block = cache->bins[cls].head))) {
+            cache->bins[cls].head = *(void **) block;
+            cache->bins[cls].count --;
+            cache->cached_bytes -= __nocl_internal_allocator_tcache_class_size(cls);
+            return block;
+        }
+        size = __nocl_internal_allocator_tcache_class_size(cls);
+    }
+    else if (size > (size_t) -1 - __NOCL_INTERNAL_ALLOCATOR_TCACHE_HEADER) return NULL;
+
+    if (!((block = ator_malloc(tcache->backend, size + __NOCL_INTERNAL_ALLOCATOR_TCACHE_HEADER)))) return NULL;
+    block += __NOCL_INTERNAL_ALLOCATOR_TCACHE_HEADER;
+    __nocl_internal_allocator_tcache_class_of(block) = cls;
+    return block;
+}
+
+static inline void *cdecl __nocl_internal_allocator_tcache_calloc(ator_t *ator, size_t num, size_t size) {
+    if (size && num > (size_t) -1 / size) return NULL;
+    void *res = __nocl_internal_allocator_tcache_malloc(ator, num * size);
+    if (res) memset(res, 0, num * size);
+    return res;
+}
+
+static inline void cdecl __nocl_internal_allocator_tcache_free(ator_t *ator, void *ptr) {
+    __nocl_internal_allocator_tcache *tcache = (__nocl_internal_allocator_tcache *) ator;
+    struct __nocl_internal_allocator_tcache_cache *cache;
+
+    if (!ptr) return;
+
+    size_t cls = __nocl_internal_allocator_tcache_class_of(ptr);
+    if (cls == __NOCL_INTERNAL_ALLOCATOR_TCACHE_NO_CLASS ||
+        !((cache = __nocl_internal_allocator_tcache_cache_get(tcache)))) {
+        ator_free(tcache->backend, (unsigned char *) ptr - __NOCL_INTERNAL_ALLOCATOR_TCACHE_HEADER);
+        return;
+    }
+
+    *(void **) ptr = cache->bins[cls].head;
+    cache->bins[cls].head = ptr;
+    cache->bins[cls].count ++;
+    cache->cached_bytes += __nocl_internal_allocator_tcache_class_size(cls);
+
+    if (cache->cached_bytes > tcache->max_cached_bytes)
+        __nocl_internal_allocator_tcache_flush(cache, cls, (cache->bins[cls].count + 1) / 2);
+}
+
+static inline void *cdecl __nocl_internal_allocator_tcache_realloc(ator_t *ator, void *ptr, size_t size) {
+    if (!ptr) return __nocl_internal_allocator_tcache_malloc(ator, size);
+
+    size_t cls = __nocl_internal_allocator_tcache_class_of(ptr);
+    if (cls != __NOCL_INTERNAL_ALLOCATOR_TCACHE_NO_CLASS) {
+        size_t old_size = __nocl_internal_allocator_tcache_class_size(cls);
+        if (size <= old_size) return ptr;
+
+        void *res = __nocl_internal_allocator_tcache_malloc(ator, size);
+        if (!res) return NULL;
+        memcpy(res, ptr, old_size);
+        __nocl_internal_allocator_tcache_free(ator, ptr);
+        return res;
+    }
+
+    /* Uncached blocks stay uncached unless they shrink into a class. */
+    if (__nocl_internal_allocator_tcache_class(size) == __NOCL_INTERNAL_ALLOCATOR_TCACHE_NO_CLASS) {
+        __nocl_internal_allocator_tcache *tcache = (__nocl_internal_allocator_tcache *) ator;
+        unsigned char *block;
+        if (size > (size_t) -1 - __NOCL_INTERNAL_ALLOCATOR_TCACHE_HEADER) return NULL;
+        if (!((block = ator_realloc(tcache->backend, (unsigned char *) ptr - __NOCL_INTERNAL_ALLOCATOR_TCACHE_HEADER,
+            size + __NOCL_INTERNAL_ALLOCATOR_TCACHE_HEADER)))) return NULL;
+        return block + __NOCL_INTERNAL_ALLOCATOR_TCACHE_HEADER;
+    }
+
+    void *res = __nocl_internal_allocator_tcache_malloc(ator, size);
+    if (!res) return NULL;
+    memcpy(res, ptr, size);
+    __nocl_internal_allocator_tcache_free(ator, ptr);
+    return res;
+}
+
+static inline void cdecl __nocl_internal_allocator_tcache_destroy(ator_t *ator) {
+    __nocl_internal_allocator_tcache *tcache = (__nocl_internal_allocator_tcache *) ator;
+    struct __nocl_internal_allocator_tcache_cache *cache, *next;
+    size_t cls;
+
+    /* No destructor runs for this key once it is deleted. */
+    tss_delete(tcache->key);
+
+    for (cache = tcache->caches; cache; cache = next) {
+        next = cache->next;
+        for (cls = 0; cls < __NOCL_INTERNAL_ALLOCATOR_TCACHE_CLASSES; cls ++)
+            __nocl_internal_allocator_tcache_flush(cache, cls, cache->bins[cls].count);
+        free(cache);
+    }
+
+    mtx_destroy(&tcache->lock);
+    free(tcache);
+}
+
+/* Hand the calling thread's cached blocks back before trimming the backend. */
+static inline size_t cdecl __nocl_internal_allocator_tcache_trim(ator_t *ator, size_t target, ator_trim_stats_t *stats) {
+    __nocl_internal_allocator_tcache *tcache = (__nocl_internal_allocator_tcache *) ator;
+    struct __nocl_internal_allocator_tcache_cache *cache = tss_get(tcache->key);
+    size_t cls;
+
+    if (cache && target != (size_t) -1) {
+        for (cls = 0; cls < __NOCL_INTERNAL_ALLOCATOR_TCACHE_CLASSES; cls ++)
+            __nocl_internal_allocator_tcache_flush(cache, cls, cache->bins[cls].count);
+    }
+
+    size_t res = target != (size_t) -1 ? ator_trim(tcache->backend, target) : 0;
+    if (stats) ator_trim_stats(tcache->backend, stats);
+    return res;
+}
+
+/*
+ * Put a per-thread cache in front of 'backend'. Each thread keeps at most
+ * 'max_cached_bytes' (0 for the default) of freed blocks.
+ */
+static inline ator_t *cdecl ator_create_tcache(ator_t *backend, size_t max_cached_bytes) {
+    __nocl_internal_allocator_tcache *tcache = malloc(sizeof(__nocl_internal_allocator_tcache));
+    if (!tcache) return NULL;
+
+    if (tss_create(&tcache->key, __nocl_internal_allocator_tcache_cache_dtor) != thrd_success) {
+        free(tcache);
+        return NULL;
+    }
+    if (mtx_init(&tcache->lock, mtx_plain) != thrd_success) {
+        tss_delete(tcache->key);
+        free(tcache);
+        return NULL;
+    }
+
+    tcache->base.f_malloc  = NULL;
+    tcache->base.f_calloc  = NULL;
+    tcache->base.f_realloc = NULL;
+    tcache->base.f_free    = NULL;
+
+    tcache->base.f_malloc_ex  = __nocl_internal_allocator_tcache_malloc;
+    tcache->base.f_calloc_ex  = __nocl_internal_allocator_tcache_calloc;
+    tcache->base.f_realloc_ex = __nocl_internal_allocator_tcache_realloc;
+    tcache->base.f_free_ex    = __nocl_internal_allocator_tcache_free;
+    tcache->base.f_destroy_ex = __nocl_internal_allocator_tcache_destroy;
+
+    tcache->base.f_malloc_batch_ex = NULL;
+    tcache->base.f_free_batch_ex   = NULL;
+
+    tcache->base.f_trim_ex = __nocl_internal_allocator_tcache_trim;
+
+    tcache->backend = backend;
+    tcache->max_cached_bytes = max_cached_bytes ? max_cached_bytes : __NOCL_INTERNAL_ALLOCATOR_TCACHE_MAX_CACHED;
+    tcache->caches = NULL;
+
+    return &tcache->base;
+}
+
+#endif
+
+/*
+ * Instrumented wrapper.
+ *
+ * Counters live in cache-line sized shards picked per thread and are only
+ * touched with relaxed atomics. Live bytes are folded into a shared total
+ * once a shard has drifted by __NOCL_INTERNAL_ALLOCATOR_STATS_SLACK bytes,
+ * so 'peak_bytes' may lag the true peak by up to that much per shard.
+ */
+
+#if defined(NOCL_FEATURE_NO_THREADS) || defined(NOCL_FEATURE_NO_STDATOMIC)
+
+#define NOCL_FEATURE_NO_ALLOCATOR_STATS
+
+#else
+
+#define ATOR_STATS_BUCKETS  64
+
+#define __NOCL_INTERNAL_ALLOCATOR_CACHE_LINE    64
+#define __NOCL_INTERNAL_ALLOCATOR_STATS_SHARDS  16
+#define __NOCL_INTERNAL_ALLOCATOR_STATS_SLACK   65536
+
+typedef struct ator_stats_t {
+    size_t mallocs;
+    size_t callocs;
+    size_t reallocs;
+    size_t frees;
+    size_t failures;
+    size_t bytes_allocated;
+    size_t bytes_freed;
+    size_t bytes_live;
+    size_t peak_bytes;
+    size_t realloc_grows;
+    size_t realloc_shrinks;
+    size_t realloc_grow_bytes;
+    size_t histogram[ATOR_STATS_BUCKETS];  /* Requests by floor(log2(size)). */
+} ator_stats_t;
+
+/* Per-thread hint for picking a shard; 0 until first use. */
+_Selectany thread_local unsigned int __nocl_internal_allocator_shard_hint = 0;
+_Selectany atomic_uint __nocl_internal_allocator_shard_next = 0;
+
+static inline unsigned int cdecl __nocl_internal_allocator_shard(unsigned int shards) {
+    unsigned int hint = __nocl_internal_allocator_shard_hint;
+    if (!hint) {
+        hint = atomic_fetch_add_explicit(&__nocl_internal_allocator_shard_next, 1, memory_order_relaxed) + 1;
+        if (!hint) hint = 1;
+        __nocl_internal_allocator_shard_hint = hint;
+    }
+    return (hint - 1) % shards;
+}
+
+static inline unsigned int cdecl __nocl_internal_allocator_log2(size_t n) {
+
+#if /* GCC 3.4.0 */ defined(__GNUC__) && (__GNUC__ >= 4 || (defined(__GNUC_MINOR__) && __GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+
+    return n ? (unsigned int) (sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(n)) : 0;
+
+#else
+
+    unsigned int res = 0;
+    while (n >>= 1) res ++;
+    return res;
+
+#endif
+
+}
+
+struct __nocl_internal_allocator_stats_counters {
+    atomic_size_t mallocs;
+    atomic_size_t callocs;
+    atomic_size_t reallocs;
+    atomic_size_t frees;
+    atomic_size_t failures;
+    atomic_size_t bytes_allocated;
+    atomic_size_t bytes_freed;
+    atomic_size_t realloc_grows;
+    atomic_size_t realloc_shrinks;
+    atomic_size_t realloc_grow_bytes;
+    atomic_llong pending;
+    atomic_size_t histogram[ATOR_STATS_BUCKETS];
+};
+
+struct __nocl_internal_allocator_stats_shard {
+    struct __nocl_internal_allocator_stats_counters counters;
+    unsigned char pad[__NOCL_INTERNAL_ALLOCATOR_CACHE_LINE -
+        sizeof(struct __nocl_internal_allocator_stats_counters) % __NOCL_INTERNAL_ALLOCATOR_CACHE_LINE];
+};
+
+typedef struct __nocl_internal_allocator_stats {
+    ator_t base;
+    ator_t *inner;
+    void *block;
+    atomic_llong live;
+    atomic_llong peak;
+    struct __nocl_internal_allocator_stats_shard *shards;
+} __nocl_internal_allocator_stats;
+
+#define __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER  __NOCL_INTERNAL_ALLOCATOR_ALIGN
+
+#define __nocl_internal_allocator_stats_size_of(ptr) \
+    (*(size_t *) ((unsigned char *) (ptr) - __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER))
+
+#define __nocl_internal_allocator_stats_add(obj,arg) \
+    atomic_fetch_add_explicit((obj), (arg), memory_order_relaxed)
+
+static inline struct __nocl_internal_allocator_stats_counters *cdecl __nocl_internal_allocator_stats_counters_get(__nocl_internal_allocator_stats *stats) {
+    return &stats->shards[__nocl_internal_allocator_shard(__NOCL_INTERNAL_ALLOCATOR_STATS_SHARDS)].counters;
+}
+
+/* Account 'delta' live bytes, publishing to the shared total once the shard drifts far enough. */
+static inline void cdecl __nocl_internal_allocator_stats_live(__nocl_internal_allocator_stats *stats,
+    struct __nocl_internal_allocator_stats_counters *counters, long long delta) {
+
+    long long pending = __nocl_internal_allocator_stats_add(&counters->pending, delta) + delta;
+    if (pending < __NOCL_INTERNAL_ALLOCATOR_STATS_SLACK && pending > -__NOCL_INTERNAL_ALLOCATOR_STATS_SLACK) return;
+
+    pending = atomic_exchange_explicit(&counters->pending, 0, memory_order_relaxed);
+    long long live = __nocl_internal_allocator_stats_add(&stats->live, pending) + pending;
+    long long peak = atomic_load_explicit(&stats->peak, memory_order_relaxed);
+    while (live > peak &&
+        !atomic_compare_exchange_weak_explicit(&stats->peak, &peak, live, memory_order_relaxed, memory_order_relaxed));
+}
+
+static inline void *cdecl __nocl_internal_allocator_stats_track(__nocl_internal_allocator_stats *stats,
+    struct __nocl_internal_allocator_stats_counters *counters, unsigned char *block, size_t size) {
+
+    if (!block) {
+        __nocl_internal_allocator_stats_add(&counters->failures, 1);
+        return NULL;
+    }
+
+    block += __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER;
+    __nocl_internal_allocator_stats_size_of(block) = size;
+    __nocl_internal_allocator_stats_add(&counters->bytes_allocated, size);
+    __nocl_internal_allocator_stats_add(&counters->histogram[__nocl_internal_allocator_log2(size)], 1);
+    __nocl_internal_allocator_stats_live(stats, counters, (long long) size);
+    return block;
+}
+
+static inline void *cdecl __nocl_internal_allocator_stats_malloc(ator_t *ator, size_t size) {
+    __nocl_internal_allocator_stats *stats = (__nocl_internal_allocator_stats *) ator;
+    struct __nocl_internal_allocator_stats_counters *counters = __nocl_internal_allocator_stats_counters_get(stats);
+
+    __nocl_internal_allocator_stats_add(&counters->mallocs, 1);
+    if (size > (size_t) -1 - __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER) return __nocl_internal_allocator_stats_track(stats, counters, NULL, 0);
+    return __nocl_internal_allocator_stats_track(stats, counters,
+        ator_malloc(stats->inner, size + __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER), size);
+}
+
+static inline void *cdecl __nocl_internal_allocator_stats_calloc(ator_t *ator, size_t num, size_t size) {
+    __nocl_internal_allocator_stats *stats = (__nocl_internal_allocator_stats *) ator;
+    struct __nocl_internal_allocator_stats_counters *counters = __nocl_internal_allocator_stats_counters_get(stats);
+
+    __nocl_internal_allocator_stats_add(&counters->callocs, 1);
+    if ((size && num > (size_t) -1 / size) || num * size > (size_t) -1 - __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER)
+        return __nocl_internal_allocator_stats_track(stats, counters, NULL, 0);
+
+    /* The header is one extra element when 'size' divides it, otherwise zero the whole block ourselves. */
+    unsigned char *block;
+    if (size && !(__NOCL_INTERNAL_ALLOCATOR_STATS_HEADER % size))
+        block = ator_calloc(stats->inner, num + __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER / size, size);
+    else if ((block = ator_malloc(stats->inner, num * size + __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER)))
+        memset(block, 0, num * size + __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER);
+    return __nocl_internal_allocator_stats_track(stats, counters, block, num * size);
+}
+
+static inline void *cdecl __nocl_internal_allocator_stats_realloc(ator_t *ator, void *ptr, size_t size) {
+    __nocl_internal_allocator_stats *stats = (__nocl_internal_allocator_stats *) ator;
+    struct __nocl_internal_allocator_stats_counters *counters = __nocl_internal_allocator_stats_counters_get(stats);
+
+    if (!ptr) return __nocl_internal_allocator_stats_malloc(ator, size);
+
+    __nocl_internal_allocator_stats_add(&counters->reallocs, 1);
+    if (size > (size_t) -1 - __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER) return __nocl_internal_allocator_stats_track(stats, counters, NULL, 0);
+
+    size_t old_size = __nocl_internal_allocator_stats_size_of(ptr);
+    unsigned char *block = ator_realloc(stats->inner, (unsigned char *) ptr - __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER,
+        size + __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER);
+    if (!block) return __nocl_internal_allocator_stats_track(stats, counters, NULL, 0);
+
+    if (size > old_size) {
+        __nocl_internal_allocator_stats_add(&counters->realloc_grows, 1);
+        __nocl_internal_allocator_stats_add(&counters->realloc_grow_bytes, size - old_size);
+    }
+    else __nocl_internal_allocator_stats_add(&counters->realloc_shrinks, 1);
+
+    __nocl_internal_allocator_stats_add(&counters->bytes_freed, old_size);
+    __nocl_internal_allocator_stats_live(stats, counters, -(long long) old_size);
+    return __nocl_internal_allocator_stats_track(stats, counters, block, size);
+}
+
+static inline void cdecl __nocl_internal_allocator_stats_free(ator_t *ator, void *ptr) {
+    __nocl_internal_allocator_stats *stats = (__nocl_internal_allocator_stats *) ator;
+    struct __nocl_internal_allocator_stats_counters *counters;
+
+    if (!ptr) return;
+
+    size_t size = __nocl_internal_allocator_stats_size_of(ptr);
+    counters = __nocl_internal_allocator_stats_counters_get(stats);
+    __nocl_internal_allocator_stats_add(&counters->frees, 1);
+    __nocl_internal_allocator_stats_add(&counters->bytes_freed, size);
+    __nocl_internal_allocator_stats_live(stats, counters, -(long long) size);
+    ator_free(stats->inner, (unsigned char *) ptr - __NOCL_INTERNAL_ALLOCATOR_STATS_HEADER);
+}
+
+static inline void cdecl __nocl_internal_allocator_stats_destroy(ator_t *ator) {
+    __nocl_internal_allocator_stats *stats = (__nocl_internal_allocator_stats *) ator;
+    aligned_free_large(stats->block);
+}
+
+static inline size_t cdecl __nocl_internal_allocator_stats_trim(ator_t *ator, size_t target, ator_trim_stats_t *stats) {
+    __nocl_internal_allocator_stats *stats_ator = (__nocl_internal_allocator_stats *) ator;
+    size_t res = target != (size_t) -1 ? ator_trim(stats_ator->inner, target) : 0;
+    if (stats) ator_trim_stats(stats_ator->inner, stats);
+    return res;
+}
+
+/* Wrap 'inner' with call, byte and size counters. */
+static inline ator_t *cdecl ator_create_stats(ator_t *inner) {
+    size_t offset = __nocl_internal_allocator_align_up(sizeof(__nocl_internal_allocator_stats), __NOCL_INTERNAL_ALLOCATOR_CACHE_LINE);
+
+    /* Header and shards share one cache-line aligned, zeroed block. */
+    unsigned char *block = aligned_calloc_large(1, offset + sizeof(struct __nocl_internal_allocator_stats_shard) * __NOCL_INTERNAL_ALLOCATOR_STATS_SHARDS,
+        __NOCL_INTERNAL_ALLOCATOR_CACHE_LINE, ALIGNED_LARGE_DEFAULT);
+    if (!block) return NULL;
+
+    __nocl_internal_allocator_stats *stats = (__nocl_internal_allocator_stats *) block;
+
+    stats->base.f_malloc  = NULL;
+    stats->base.f_calloc  = NULL;
+    stats->base.f_realloc = NULL;
+    stats->base.f_free    = NULL;
+
+    stats->base.f_malloc_ex  = __nocl_internal_allocator_stats_malloc;
+    stats->base.f_calloc_ex  = __nocl_internal_allocator_stats_calloc;
+    stats->base.f_realloc_ex = __nocl_internal_allocator_stats_realloc;
+    stats->base.f_free_ex    = __nocl_internal_allocator_stats_free;
+    stats->base.f_destroy_ex = __nocl_internal_allocator_stats_destroy;
+
+    stats->base.f_malloc_batch_ex = NULL;
+    stats->base.f_free_batch_ex   = NULL;
+
+    stats->base.f_trim_ex = __nocl_internal_allocator_stats_trim;
+
+    stats->inner = inner;
+    stats->block = block;
+    stats->shards = (struct __nocl_internal_allocator_stats_shard *) (block + offset);
+
+    return &stats->base;
+}
+
+/* Sum the shards into 'out'. Counters may move while this runs. */
+static inline void cdecl ator_stats_snapshot(ator_t *ator, ator_stats_t *out) {
+    __nocl_internal_allocator_stats *stats = (__nocl_internal_allocator_stats *) ator;
+    size_t i, j;
+
+    memset(out, 0, sizeof(ator_stats_t));
+
+    for (i = 0; i < __NOCL_INTERNAL_ALLOCATOR_STATS_SHARDS; i ++) {
+        struct __nocl_internal_allocator_stats_counters *counters = &stats->shards[i].counters;
+        out->mallocs            += atomic_load_explicit(&counters->mallocs, memory_order_relaxed);
+        out->callocs            += atomic_load_explicit(&counters->callocs, memory_order_relaxed);
+        out->reallocs           += atomic_load_explicit(&counters->reallocs, memory_order_relaxed);
+        out->frees              += atomic_load_explicit(&counters->frees, memory_order_relaxed);
+        out->failures           += atomic_load_explicit(&counters->failures, memory_order_relaxed);
+        out->bytes_allocated    += atomic_load_explicit(&counters->bytes_allocated, memory_order_relaxed);
+        out->bytes_freed        += atomic_load_explicit(&counters->bytes_freed, memory_order_relaxed);
+        out->realloc_grows      += atomic_load_explicit(&counters->realloc_grows, memory_order_relaxed);
+        out->realloc_shrinks    += atomic_load_explicit(&counters->realloc_shrinks, memory_order_relaxed);
+        out->realloc_grow_bytes += atomic_load_explicit(&counters->realloc_grow_bytes, memory_order_relaxed);
+        for (j = 0; j < ATOR_STATS_BUCKETS; j ++)
+            out->histogram[j] += atomic_load_explicit(&counters->histogram[j], memory_order_relaxed);
+    }
+
+    out->bytes_live = out->bytes_allocated > out->bytes_freed ? out->bytes_allocated - out->bytes_freed : 0;
+    long long peak = atomic_load_explicit(&stats->peak, memory_order_relaxed);
+    out->peak_bytes = (size_t) peak > out->bytes_live ? (size_t) peak : out->bytes_live;
+}
+
+static inline void cdecl ator_stats_dump(ator_t *ator, FILE *stream) {
+    ator_stats_t snapshot;
+    size_t i;
+
+    ator_stats_snapshot(ator, &snapshot);
+
+    fprintf(stream, "calls: malloc %lu, calloc %lu, realloc %lu, free %lu, failed %lu\n",
+        (unsigned long) snapshot.mallocs, (unsigned long) snapshot.callocs, (unsigned long) snapshot.reallocs,
+        (unsigned long) snapshot.frees, (unsigned long) snapshot.failures);
+    fprintf(stream, "bytes: allocated %lu, freed %lu, live %lu, peak %lu\n",
+        (unsigned long) snapshot.bytes_allocated, (unsigned long) snapshot.bytes_freed,
+        (unsigned long) snapshot.bytes_live, (unsigned long) snapshot.peak_bytes);
+    fprintf(stream, "realloc: grew %lu (%lu bytes), shrank %lu\n",
+        (unsigned long) snapshot.realloc_grows, (unsigned long) snapshot.realloc_grow_bytes,
+        (unsigned long) snapshot.realloc_shrinks);
+
+    for (i = 0; i < ATOR_STATS_BUCKETS; i ++) {
+        if (snapshot.histogram[i])
+            fprintf(stream, "size 2^%lu: %lu\n", (unsigned long) i, (unsigned long) snapshot.histogram[i]);
+    }
+}
+
+#endif
+
+/*
+ * NUMA placement policies.
+ *
+ * On Linux with more than one memory node, every block of at least
+ * NOCL_ALLOCATOR_NUMA_THRESHOLD bytes is mapped on its own pages and bound
+ * with mbind(2), issued as a raw system call so libnuma is not needed.
+ * Smaller blocks come from the heap unbound, since a mapping and a system
+ * call per block would cost far more than remote accesses save. Elsewhere,
+ * including single-node machines, the allocator degrades to
+ * 'aligned_malloc_large' without any binding.
+ */
+
+#if !defined(NOCL_ALLOCATOR_NUMA_THRESHOLD)
+
+#define NOCL_ALLOCATOR_NUMA_THRESHOLD  NOCL_ALLOCATOR_LARGE_THRESHOLD
+
+#endif
+
+#define ATOR_NUMA_FIRST_TOUCH  0  /* Pages land on the node of the first thread touching them. */
+#define ATOR_NUMA_LOCAL        1  /* Prefer the node of the allocating thread. */
+#define ATOR_NUMA_INTERLEAVE   2  /* Spread pages round-robin across all allowed nodes. */
+#define ATOR_NUMA_BIND         3  /* Only use the given node. */
+
+#if defined(__linux__) && defined(__NOCL_INTERNAL_ALLOCATOR_HAS_MMAP)
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* syscall(2) is only declared with the BSD/GNU extensions. */
+#if defined(SYS_mbind) && defined(SYS_get_mempolicy) && defined(SYS_getcpu) && \
+    (defined(_GNU_SOURCE) || defined(_DEFAULT_SOURCE) || defined(_BSD_SOURCE) || defined(__USE_MISC))
+
+#define __NOCL_INTERNAL_ALLOCATOR_HAS_NUMA
+
+#endif
+
+#endif
+
+#define __NOCL_INTERNAL_ALLOCATOR_MPOL_PREFERRED       1
+#define __NOCL_INTERNAL_ALLOCATOR_MPOL_BIND            2
+#define __NOCL_INTERNAL_ALLOCATOR_MPOL_INTERLEAVE      3
+#define __NOCL_INTERNAL_ALLOCATOR_MPOL_F_NODE          1
+#define __NOCL_INTERNAL_ALLOCATOR_MPOL_F_ADDR          2
+#define __NOCL_INTERNAL_ALLOCATOR_MPOL_F_MEMS_ALLOWED  4
+#define __NOCL_INTERNAL_ALLOCATOR_MPOL_MF_MOVE         2
+
+#define __NOCL_INTERNAL_ALLOCATOR_NUMA_MAX_NODES  1024
+#define __NOCL_INTERNAL_ALLOCATOR_NUMA_MASK_BITS  (sizeof(unsigned long) * 8)
+
+typedef struct __nocl_internal_allocator_numa {
+    ator_t base;
+    int policy;
+    int active;
+    unsigned long mask[__NOCL_INTERNAL_ALLOCATOR_NUMA_MAX_NODES / __NOCL_INTERNAL_ALLOCATOR_NUMA_MASK_BITS];
+} __nocl_internal_allocator_numa;
+
+/* Node of the page holding 'ptr', or -1 if unknown. */
+static inline int cdecl ator_numa_node_of(const void *ptr) {
+
+#if defined(__NOCL_INTERNAL_ALLOCATOR_HAS_NUMA)
+
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, NULL, 0UL, ptr,
+        __NOCL_INTERNAL_ALLOCATOR_MPOL_F_NODE | __NOCL_INTERNAL_ALLOCATOR_MPOL_F_ADDR) != 0) return -1;
+    return node;
+
+#else
+
+    (void) ptr;
+    return -1;
+
+#endif
+
+}
+
+#if defined(__NOCL_INTERNAL_ALLOCATOR_HAS_NUMA)
+
+static inline void cdecl __nocl_internal_allocator_numa_bind(__nocl_internal_allocator_numa *numa, void *ptr) {
+    struct __nocl_internal_allocator_large_header *header = __nocl_internal_allocator_large_header_of(ptr);
+    unsigned long local[sizeof(numa->mask) / sizeof(unsigned long)];
+    const unsigned long *mask = numa->mask;
+    int mode;
+
+    switch (numa->policy) {
+        case ATOR_NUMA_LOCAL: {
+            unsigned int cpu, node;
+            if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || node >= __NOCL_INTERNAL_ALLOCATOR_NUMA_MAX_NODES) return;
+            memset(local, 0, sizeof(local));
+            local[node / __NOCL_INTERNAL_ALLOCATOR_NUMA_MASK_BITS] = 1UL << (node % __NOCL_INTERNAL_ALLOCATOR_NUMA_MASK_BITS);
+            mask = local;
+            mode = __NOCL_INTERNAL_ALLOCATOR_MPOL_PREFERRED;
+            break;
+        }
+        case ATOR_NUMA_INTERLEAVE:
+            mode = __NOCL_INTERNAL_ALLOCATOR_MPOL_INTERLEAVE;
+            break;
+        case ATOR_NUMA_BIND:
+            mode = __NOCL_INTERNAL_ALLOCATOR_MPOL_BIND;
+            break;
+        default:
+            return;
+    }
+
+    /* The header page is already resident; MPOL_MF_MOVE migrates it too. */
+    syscall(SYS_mbind, header->base, header->length, mode, mask,
+        (unsigned long) __NOCL_INTERNAL_ALLOCATOR_NUMA_MAX_NODES, __NOCL_INTERNAL_ALLOCATOR_MPOL_MF_MOVE);
+}
+
+#endif
+
+static inline void *cdecl __nocl_internal_allocator_numa_malloc(ator_t *ator, size_t size) {
+
+#if defined(__NOCL_INTERNAL_ALLOCATOR_HAS_NUMA)
+
+    __nocl_internal_allocator_numa *numa = (__nocl_internal_allocator_numa *) ator;
+    if (numa->active && size >= NOCL_ALLOCATOR_NUMA_THRESHOLD) {
+        void *res = __nocl_internal_allocator_large_map(size, __NOCL_INTERNAL_ALLOCATOR_ALIGN, ALIGNED_LARGE_DEFAULT);
+        if (res) __nocl_internal_allocator_numa_bind(numa, res);
+        return res;
+    }
+
+#else
+
+    (void) ator;
+
+#endif
+
+    return aligned_malloc_large(size, __NOCL_INTERNAL_ALLOCATOR_ALIGN, ALIGNED_LARGE_DEFAULT);
+}
+
+static inline void *cdecl __nocl_internal_allocator_numa_calloc(ator_t *ator, size_t num, size_t size) {
+    if (size && num > (size_t) -1 / size) return NULL;
+    void *res = __nocl_internal_allocator_numa_malloc(ator, num * size);
+    if (res && !__nocl_internal_allocator_large_header_of(res)->length) memset(res, 0, num * size);
+    return res;
+}
+
+static inline void *cdecl __nocl_internal_allocator_numa_realloc(ator_t *ator, void *ptr, size_t size) {
+    void *res;
+    uintptr_t old;
+
+    if (!ptr) return __nocl_internal_allocator_numa_malloc(ator, size);
+
+    /* 'ptr' may be freed by the call, so only its address is kept. */
+    old = (uintptr_t) ptr;
+    res = aligned_realloc_large(ptr, size, __NOCL_INTERNAL_ALLOCATOR_ALIGN, ALIGNED_LARGE_DEFAULT);
+
+#if defined(__NOCL_INTERNAL_ALLOCATOR_HAS_NUMA)
+
+    /* A moved mapping keeps its policy, but a fresh copy has none yet. */
+    __nocl_internal_allocator_numa *numa = (__nocl_internal_allocator_numa *) ator;
+    if (numa->active && res && (uintptr_t) res != old && __nocl_internal_allocator_large_header_of(res)->length)
+        __nocl_internal_allocator_numa_bind(numa, res);
+
+#else
+
+    (void) ator;
+    (void) old;
+
+#endif
+
+    return res;
+}
+
+static inline void cdecl __nocl_internal_allocator_numa_free(ator_t *ator, void *ptr) {
+    (void) ator;
+    aligned_free_large(ptr);
+}
+
+static inline void cdecl __nocl_internal_allocator_numa_destroy(ator_t *ator) {
+    free(ator);
+}
+
+/*
+ * Create an allocator placing memory by 'policy', one of the ATOR_NUMA_*
+ * constants. 'node' is only used by ATOR_NUMA_BIND.
+ */
+static inline ator_t *cdecl ator_create_numa(int policy, int node) {
+    __nocl_internal_allocator_numa *numa = calloc(1, sizeof(__nocl_internal_allocator_numa));
+    if (!numa) return NULL;
+
+    numa->base.f_malloc  = NULL;
+    numa->base.f_calloc  = NULL;
+    numa->base.f_realloc = NULL;
+    numa->base.f_free    = NULL;
+
+    numa->base.f_malloc_ex  = __nocl_internal_allocator_numa_malloc;
+    numa->base.f_calloc_ex  = __nocl_internal_allocator_numa_calloc;
+    numa->base.f_realloc_ex = __nocl_internal_allocator_numa_realloc;
+    numa->base.f_free_ex    = __nocl_internal_allocator_numa_free;
+    numa->base.f_destroy_ex = __nocl_internal_allocator_numa_destroy;
+
+    numa->base.f_malloc_batch_ex = NULL;
+    numa->base.f_free_batch_ex   = NULL;
+
+    numa->base.f_trim_ex = NULL;
+
+    numa->policy = policy;
+
+#if defined(__NOCL_INTERNAL_ALLOCATOR_HAS_NUMA)
+
+    /* Binding only pays off with more than one node to choose from. */
+    size_t i, nodes = 0;
+    int mode;
+    if (syscall(SYS_get_mempolicy, &mode, numa->mask, (unsigned long) __NOCL_INTERNAL_ALLOCATOR_NUMA_MAX_NODES, NULL,
+        __NOCL_INTERNAL_ALLOCATOR_MPOL_F_MEMS_ALLOWED) == 0) {
+        for (i = 0; i < __NOCL_INTERNAL_ALLOCATOR_NUMA_MAX_NODES; i ++)
+            nodes += (numa->mask[i / __NOCL_INTERNAL_ALLOCATOR_NUMA_MASK_BITS] >> (i % __NOCL_INTERNAL_ALLOCATOR_NUMA_MASK_BITS)) & 1;
+    }
+
+    if (policy == ATOR_NUMA_BIND) {
+        if (node < 0 || node >= __NOCL_INTERNAL_ALLOCATOR_NUMA_MAX_NODES ||
+            !((numa->mask[node / __NOCL_INTERNAL_ALLOCATOR_NUMA_MASK_BITS] >> (node % __NOCL_INTERNAL_ALLOCATOR_NUMA_MASK_BITS)) & 1)) {
+            free(numa);
+            return NULL;
+        }
+        memset(numa->mask, 0, sizeof(numa->mask));
+        numa->mask[node / __NOCL_INTERNAL_ALLOCATOR_NUMA_MASK_BITS] = 1UL << (node % __NOCL_INTERNAL_ALLOCATOR_NUMA_MASK_BITS);
+    }
+
+    numa->active = nodes > 1 && policy != ATOR_NUMA_FIRST_TOUCH;
+
+#else
+
+    if (policy == ATOR_NUMA_BIND && node != 0) {
+        free(numa);
+        return NULL;
+    }
+
+#endif
+
+    return &numa->base;
+}
+
 #endif
 
 #if defined(__cplusplus)
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * amtx_t against mtx_t (mtx_plain) under contention: every thread takes
+ * the lock, does a short critical section and some work outside it.
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -D_GNU_SOURCE -iquote .. amtx.c -o amtx -lpthread
+ *     ./amtx [max_threads] [acquisitions_per_thread] [work_outside]
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "time.h"
+#include "threads.h"
+
+#define MAX_THREADS  256
+
+static mtx_t plain;
+static amtx_t adaptive;
+static unsigned long iterations = 1000000;
+static unsigned long outside = 50;
+static volatile unsigned long shared[8];
+
+static void work(unsigned long n) {
+    volatile unsigned long sink = 0;
+    unsigned long i;
+    for (i = 0; i < n; i ++) sink += i;
+}
+
+static void critical(void) {
+    size_t i;
+    for (i = 0; i < sizeof(shared) / sizeof(shared[0]); i ++) shared[i] ++;
+}
+
+static int bench_plain(void *arg) {
+    unsigned long i;
+    (void) arg;
+    for (i = 0; i < iterations; i ++) {
+        mtx_lock(&plain);
+        critical();
+        mtx_unlock(&plain);
+        work(outside);
+    }
+    return 0;
+}
+
+static int bench_adaptive(void *arg) {
+    unsigned long i;
+    (void) arg;
+    for (i = 0; i < iterations; i ++) {
+        amtx_lock(&adaptive);
+        critical();
+        amtx_unlock(&adaptive);
+        work(outside);
+    }
+    return 0;
+}
+
+static double run(thrd_start_t func, int threads) {
+    thrd_t thread[MAX_THREADS];
+    struct timespec start, end;
+    int i;
+
+    shared[0] = 0;
+    timespec_get(&start, TIME_UTC);
+    for (i = 0; i < threads; i ++) thrd_create(&thread[i], func, NULL);
+    for (i = 0; i < threads; i ++) thrd_join(thread[i], NULL);
+    timespec_get(&end, TIME_UTC);
+    if (shared[0] != (unsigned long) threads * iterations) {
+        fputs("amtx: mutual exclusion broken\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    return (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    int threads;
+
+    if (argc > 2) iterations = strtoul(argv[2], NULL, 10);
+    if (argc > 3) outside = strtoul(argv[3], NULL, 10);
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+
+    if (mtx_init(&plain, mtx_plain) != thrd_success || amtx_init(&adaptive) != thrd_success) {
+        fputs("amtx: cannot create the mutexes\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    printf("%8s %16s %16s %8s\n", "threads", "mtx_t Mops/s", "amtx_t Mops/s", "speedup");
+    for (threads = 1; threads <= max_threads; threads = threads < max_threads && threads * 2 > max_threads ? max_threads : threads * 2) {
+        double ops = (double) iterations * threads / 1e6;
+        double t_plain = run(bench_plain, threads);
+        double t_adaptive = run(bench_adaptive, threads);
+        printf("%8d %16.2f %16.2f %7.2fx\n", threads, ops / t_plain, ops / t_adaptive, t_plain / t_adaptive);
+    }
+
+    amtx_destroy(&adaptive);
+    mtx_destroy(&plain);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Object cache against malloc plus explicit construction, for objects
+ * embedding a mtx_t and a cnd_t, from 1 to N threads. With malloc every
+ * allocation pays mtx_init/cnd_init and every free their destroy; the
+ * cache keeps freed objects constructed.
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -iquote .. cache.c -o cache -lpthread
+ *     ./cache [max_threads] [rounds]
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "time.h"
+#include "threads.h"
+#include "allocator.h"
+
+#define MAX_THREADS  256
+#define WINDOW       64
+
+typedef struct connection {
+    mtx_t lock;
+    cnd_t ready;
+    int state;
+} connection;
+
+static ator_t *cache;
+static unsigned long rounds = 50000;
+
+static int connection_ctor(void *ptr) {
+    connection *conn = ptr;
+    if (mtx_init(&conn->lock, mtx_plain) != thrd_success) return -1;
+    if (cnd_init(&conn->ready) != thrd_success) {
+        mtx_destroy(&conn->lock);
+        return -1;
+    }
+    conn->state = 0;
+    return 0;
+}
+
+static void connection_dtor(void *ptr) {
+    connection *conn = ptr;
+    cnd_destroy(&conn->ready);
+    mtx_destroy(&conn->lock);
+}
+
+static void use(connection *conn) {
+    mtx_lock(&conn->lock);
+    conn->state ++;
+    mtx_unlock(&conn->lock);
+}
+
+static void fail(void) {
+    fputs("cache: out of memory\n", stderr);
+    exit(EXIT_FAILURE);
+}
+
+static int bench_malloc(void *arg) {
+    connection *window[WINDOW];
+    unsigned long r;
+    size_t i;
+
+    (void) arg;
+    for (r = 0; r < rounds; r ++) {
+        for (i = 0; i < WINDOW; i ++) {
+            if (!((window[i] = malloc(sizeof(connection)))) || connection_ctor(window[i])) fail();
+            use(window[i]);
+        }
+        for (i = 0; i < WINDOW; i ++) {
+            connection_dtor(window[i]);
+            free(window[i]);
+        }
+    }
+    return 0;
+}
+
+static int bench_cache(void *arg) {
+    connection *window[WINDOW];
+    unsigned long r;
+    size_t i;
+
+    (void) arg;
+    for (r = 0; r < rounds; r ++) {
+        for (i = 0; i < WINDOW; i ++) {
+            if (!((window[i] = ator_malloc(cache, sizeof(connection))))) fail();
+            use(window[i]);
+        }
+        for (i = 0; i < WINDOW; i ++) ator_free(cache, window[i]);
+    }
+    return 0;
+}
+
+static double run(thrd_start_t func, int threads) {
+    thrd_t thread[MAX_THREADS];
+    struct timespec start, end;
+    int i;
+
+    timespec_get(&start, TIME_UTC);
+    for (i = 0; i < threads; i ++) thrd_create(&thread[i], func, NULL);
+    for (i = 0; i < threads; i ++) thrd_join(thread[i], NULL);
+    timespec_get(&end, TIME_UTC);
+    return (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    int threads;
+
+    if (argc > 2) rounds = strtoul(argv[2], NULL, 10);
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+
+    if (!((cache = ator_cache_create(sizeof(connection), 0, connection_ctor, connection_dtor)))) fail();
+
+    printf("%8s %16s %16s %8s\n", "threads", "malloc Mops/s", "cache Mops/s", "speedup");
+    for (threads = 1; threads <= max_threads; threads = threads < max_threads && threads * 2 > max_threads ? max_threads : threads * 2) {
+        /* One allocation and one free per object. */
+        double ops = 2.0 * rounds * WINDOW * threads / 1e6;
+        double t_malloc = run(bench_malloc, threads);
+        double t_cache = run(bench_cache, threads);
+        printf("%8d %16.1f %16.1f %7.2fx\n", threads, ops / t_malloc, ops / t_cache, t_malloc / t_cache);
+    }
+
+    ator_destroy(cache);
+    return EXIT_SUCCESS;
+}
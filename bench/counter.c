@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Sharded counter against a single atomic_ullong, from 1 to N threads.
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -D_GNU_SOURCE -iquote .. counter.c -o counter -lpthread
+ *     ./counter [max_threads] [increments_per_thread]
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "time.h"
+#include "threads.h"
+#include "stdatomic.h"
+#include "counter.h"
+
+#define MAX_THREADS  256
+
+static nocl_counter_t sharded = NOCL_COUNTER_INIT;
+static atomic_ullong plain;
+static unsigned long iterations = 10000000;
+
+static int bench_sharded(void *arg) {
+    unsigned long i;
+    (void) arg;
+    for (i = 0; i < iterations; i ++) counter_inc(&sharded);
+    return 0;
+}
+
+static int bench_plain(void *arg) {
+    unsigned long i;
+    (void) arg;
+    for (i = 0; i < iterations; i ++) atomic_fetch_add_explicit(&plain, 1, memory_order_relaxed);
+    return 0;
+}
+
+static double run(thrd_start_t func, int threads) {
+    thrd_t thread[MAX_THREADS];
+    struct timespec start, end;
+    int i;
+
+    timespec_get(&start, TIME_UTC);
+    for (i = 0; i < threads; i ++) thrd_create(&thread[i], func, NULL);
+    for (i = 0; i < threads; i ++) thrd_join(thread[i], NULL);
+    timespec_get(&end, TIME_UTC);
+    return (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    int threads;
+
+    if (argc > 2) iterations = strtoul(argv[2], NULL, 10);
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+
+    printf("%8s %16s %16s %8s\n", "threads", "sharded Mops/s", "atomic Mops/s", "speedup");
+    for (threads = 1; threads <= max_threads; threads = threads < max_threads && threads * 2 > max_threads ? max_threads : threads * 2) {
+        double ops = (double) iterations * threads / 1e6;
+        double t_sharded, t_plain;
+
+        counter_reset(&sharded);
+        atomic_store(&plain, 0);
+        t_sharded = run(bench_sharded, threads);
+        t_plain = run(bench_plain, threads);
+        if (counter_read(&sharded) != (unsigned long long) iterations * threads ||
+            atomic_load(&plain) != (unsigned long long) iterations * threads) {
+            fputs("counter: lost increments\n", stderr);
+            return EXIT_FAILURE;
+        }
+        printf("%8d %16.1f %16.1f %7.2fx\n", threads, ops / t_sharded, ops / t_plain, t_plain / t_sharded);
+    }
+    return EXIT_SUCCESS;
+}
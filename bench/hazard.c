@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Readers of a shared node protected by hazard pointers against readers
+ * taking a mtx_t, while one writer keeps replacing the node. Reports reads
+ * per second for 1 to N readers.
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -D_GNU_SOURCE -iquote .. hazard.c -o hazard -lpthread
+ *     ./hazard [max_readers] [milliseconds_per_run] [writer_pause_us]
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "time.h"
+#include "threads.h"
+#include "stdatomic.h"
+#include "hazard.h"
+
+#define MAX_THREADS  256
+
+typedef struct node {
+    unsigned long values[8];
+} node;
+
+static nocl_hp_t *hp;
+static node *_Atomic current;
+static mtx_t lock;
+static node *locked_current;
+static atomic_int stop;
+static volatile unsigned long sink;  /* Keeps the reads from being optimized away. */
+static unsigned long writer_pause_us = 10;
+
+static node *node_new(unsigned long value) {
+    node *res = malloc(sizeof(node));
+    size_t i;
+    if (!res) {
+        fputs("hazard: out of memory\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < 8; i ++) res->values[i] = value;
+    return res;
+}
+
+static unsigned long sum(const node *n) {
+    unsigned long res = 0;
+    size_t i;
+    for (i = 0; i < 8; i ++) res += n->values[i];
+    return res;
+}
+
+static void pause_writer(void) {
+    struct timespec ts;
+    if (!writer_pause_us) return;
+    ts.tv_sec = 0;
+    ts.tv_nsec = (long) writer_pause_us * 1000;
+    thrd_sleep(&ts, NULL);
+}
+
+static int read_hazard(void *arg) {
+    unsigned long reads = 0, check = 0;
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        node *n = hp_protect(hp, 0, &current);
+        check += sum(n);
+        hp_clear(hp, 0);
+        reads ++;
+    }
+    sink = check;
+    *(unsigned long *) arg = reads;
+    return 0;
+}
+
+static int write_hazard(void *arg) {
+    unsigned long i;
+    (void) arg;
+    for (i = 1; !atomic_load_explicit(&stop, memory_order_relaxed); i ++) {
+        node *old = atomic_exchange_explicit(&current, node_new(i), memory_order_acq_rel);
+        hp_retire(hp, old, free);
+        pause_writer();
+    }
+    return 0;
+}
+
+static int read_locked(void *arg) {
+    unsigned long reads = 0, check = 0;
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        mtx_lock(&lock);
+        check += sum(locked_current);
+        mtx_unlock(&lock);
+        reads ++;
+    }
+    sink = check;
+    *(unsigned long *) arg = reads;
+    return 0;
+}
+
+static int write_locked(void *arg) {
+    unsigned long i;
+    (void) arg;
+    for (i = 1; !atomic_load_explicit(&stop, memory_order_relaxed); i ++) {
+        node *fresh = node_new(i), *old;
+        mtx_lock(&lock);
+        old = locked_current;
+        locked_current = fresh;
+        mtx_unlock(&lock);
+        free(old);
+        pause_writer();
+    }
+    return 0;
+}
+
+static double run(thrd_start_t reader, thrd_start_t writer, int readers, unsigned long ms) {
+    thrd_t thread[MAX_THREADS + 1];
+    unsigned long reads[MAX_THREADS], total = 0;
+    struct timespec ts;
+    int i;
+
+    atomic_store(&stop, 0);
+    for (i = 0; i < readers; i ++) thrd_create(&thread[i], reader, &reads[i]);
+    thrd_create(&thread[readers], writer, NULL);
+    ts.tv_sec = (time_t) (ms / 1000);
+    ts.tv_nsec = (long) (ms % 1000) * 1000000;
+    thrd_sleep(&ts, NULL);
+    atomic_store(&stop, 1);
+    for (i = 0; i <= readers; i ++) thrd_join(thread[i], NULL);
+    for (i = 0; i < readers; i ++) total += reads[i];
+    return (double) total / ((double) ms / 1000);
+}
+
+int main(int argc, char **argv) {
+    int max_readers = argc > 1 ? atoi(argv[1]) : 8;
+    unsigned long ms = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+    int readers;
+
+    if (argc > 3) writer_pause_us = strtoul(argv[3], NULL, 10);
+    if (max_readers < 1) max_readers = 1;
+    if (max_readers > MAX_THREADS) max_readers = MAX_THREADS;
+
+    if (!((hp = hp_create(NULL))) || mtx_init(&lock, mtx_plain) != thrd_success) {
+        fputs("hazard: cannot set up\n", stderr);
+        return EXIT_FAILURE;
+    }
+    atomic_store(&current, node_new(0));
+    locked_current = node_new(0);
+
+    printf("%8s %18s %18s %8s\n", "readers", "mtx_t Mreads/s", "hazard Mreads/s", "speedup");
+    for (readers = 1; readers <= max_readers; readers = readers < max_readers && readers * 2 > max_readers ? max_readers : readers * 2) {
+        double r_locked = run(read_locked, write_locked, readers, ms);
+        double r_hazard = run(read_hazard, write_hazard, readers, ms);
+        printf("%8d %18.2f %18.2f %7.2fx\n", readers, r_locked / 1e6, r_hazard / 1e6, r_hazard / r_locked);
+    }
+
+    hp_destroy(hp);
+    free(atomic_load(&current));
+    free(locked_current);
+    mtx_destroy(&lock);
+    return EXIT_SUCCESS;
+}
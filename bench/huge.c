@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+ * Random reads over a large buffer on regular pages, transparent huge
+ * pages and reserved huge pages (which fall back to transparent ones when
+ * none are reserved). Fault-in covers the first write of every page.
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -D_GNU_SOURCE -iquote .. huge.c -o huge -lpthread
+ *     ./huge [mebibytes] [reads]
+ */
+
+#include "stddef.h"
+#include "stdint.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+#include "allocator.h"
+
+static volatile uint64_t sink;  /* Keeps the reads from being optimized away. */
+
+static double elapsed(const struct timespec *start) {
+    struct timespec end;
+    timespec_get(&end, TIME_UTC);
+    return (double) (end.tv_sec - start->tv_sec) + (double) (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+    static const char *const names[3] = { "4 KiB pages", "THP (madvise)", "MAP_HUGETLB" };
+    static const int flags[3] = { ALIGNED_LARGE_DEFAULT, ALIGNED_LARGE_HUGE, ALIGNED_LARGE_HUGETLB };
+    size_t size = (size_t) (argc > 1 ? strtoul(argv[1], NULL, 10) : 1024) << 20;
+    unsigned long reads = argc > 2 ? strtoul(argv[2], NULL, 10) : 50000000;
+    size_t words = size / sizeof(uint64_t);
+    size_t i;
+
+    if (!words) return EXIT_FAILURE;
+
+    printf("%lu MiB, %lu random reads\n", (unsigned long) (size >> 20), reads);
+    printf("%14s %14s %14s %10s\n", "pages", "fault-in s", "Mreads/s", "ns/read");
+    for (i = 0; i < 3; i ++) {
+        struct timespec start;
+        uint64_t *buffer, x = 88172645463325252ULL, sum = 0;
+        double t_fault, t_read;
+        unsigned long n;
+
+        if (!((buffer = aligned_malloc_large(size, 64, flags[i])))) {
+            fprintf(stderr, "huge: cannot allocate %lu MiB\n", (unsigned long) (size >> 20));
+            return EXIT_FAILURE;
+        }
+
+        timespec_get(&start, TIME_UTC);
+        memset(buffer, 1, size);
+        t_fault = elapsed(&start);
+
+        /* xorshift64 indices, so the walk is the same for every page size. */
+        timespec_get(&start, TIME_UTC);
+        for (n = 0; n < reads; n ++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            sum += buffer[x % words];
+        }
+        t_read = elapsed(&start);
+        sink = sum;
+
+        printf("%14s %14.3f %14.1f %10.2f\n", names[i], t_fault, reads / t_read / 1e6, t_read * 1e9 / reads);
+        aligned_free_large(buffer);
+    }
+    return EXIT_SUCCESS;
+}
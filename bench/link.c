@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Link check: this file and link_unit.c both include every header and use
+ * their allocators, hooks and shared state, so a definition that is not
+ * safe to include from two translation units fails to link here, and state
+ * that should be shared but is not shows up at run time.
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -D_GNU_SOURCE -iquote .. link.c link_unit.c -o link -lpthread
+ *     ./link
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "stdatomic.h"
+#include "threads.h"
+#include "allocator.h"
+#include "counter.h"
+#include "spsc.h"
+#include "mpmc.h"
+#include "ebr.h"
+#include "hazard.h"
+#include "seqlock.h"
+
+nocl_counter_t link_counter = NOCL_COUNTER_INIT;
+
+/* Defined in link_unit.c; returns the unit's scratch arena, or NULL on failure. */
+ator_t *link_unit_run(void);
+
+static int freed;
+
+static void count_free(void *ptr) {
+    free(ptr);
+    freed ++;
+}
+
+/* Arena, pool, cache, hazard pointers, seqlock and adaptive mutex. */
+static ator_t *run(void) {
+    ator_t *arena = ator_create_arena(0, ATOR_DEFAULT);
+    ator_t *pool = ator_create_pool(32, 0, ATOR_DEFAULT);
+    ator_t *cache = ator_cache_create(48, 0, NULL, NULL);
+    nocl_hp_t *hp = hp_create(ATOR_DEFAULT);
+    nocl_seqlock_t sl = NOCL_SEQLOCK_INIT;
+    void *_Atomic shared;
+    ator_scratch_t scope;
+    amtx_t mtx;
+    int value = 42, copy = 0, ok;
+
+    ok = arena && pool && cache && hp && amtx_init(&mtx) == thrd_success;
+    if (ok) {
+        ok = ator_malloc(arena, 100) && ator_malloc(pool, 32) && ator_malloc(cache, 48);
+
+        atomic_init(&shared, malloc(16));
+        ok = ok && hp_protect(hp, 0, &shared) == atomic_load(&shared);
+        hp_clear(hp, 0);
+        hp_retire(hp, atomic_exchange(&shared, NULL), count_free);
+
+        seqlock_write(&sl, &copy, &value, sizeof(int));
+        seqlock_read(&sl, &value, &copy, sizeof(int));
+        ok = ok && value == 42;
+
+        amtx_lock(&mtx);
+        amtx_unlock(&mtx);
+        amtx_destroy(&mtx);
+    }
+
+    if (hp) hp_destroy(hp);
+    if (cache) ator_destroy(cache);
+    if (pool) ator_destroy(pool);
+    if (arena) ator_destroy(arena);
+    ok = ok && freed == 1;
+
+    counter_inc(&link_counter);
+    scope = ator_scratch_begin();
+    ator_scratch_end(scope);
+    return ok ? scope.ator : NULL;
+}
+
+int main(void) {
+    ator_t *unit_scratch = link_unit_run(), *scratch = run();
+    unsigned long long total;
+
+    if (!unit_scratch || !scratch) {
+        fputs("link: a header function misbehaved\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    /* Both units must see the same per-thread scratch arena and counter. */
+    if (unit_scratch != scratch) {
+        fputs("link: each unit got its own scratch arena\n", stderr);
+        return EXIT_FAILURE;
+    }
+    total = counter_read(&link_counter);
+    if (total != 2) {
+        fprintf(stderr, "link: shared counter reads %llu, expected 2\n", total);
+        return EXIT_FAILURE;
+    }
+
+    puts("link: ok");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Second translation unit of the link check; see link.c.
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdatomic.h"
+#include "threads.h"
+#include "allocator.h"
+#include "counter.h"
+#include "spsc.h"
+#include "mpmc.h"
+#include "ebr.h"
+#include "hazard.h"
+#include "seqlock.h"
+
+extern nocl_counter_t link_counter;
+
+ator_t *link_unit_run(void);
+
+typedef struct pair {
+    unsigned long a, b, c;
+} pair;
+
+/* Scratch arena, NUMA allocator, queues, epochs and generic atomics. */
+ator_t *link_unit_run(void) {
+    ator_t *numa = ator_create_numa(ATOR_NUMA_LOCAL, 0);
+    nocl_spsc_t *ring = spsc_create(sizeof(int), 8, 0);
+    nocl_mpmc_t *queue = mpmc_create(sizeof(int), 8, 0);
+    nocl_ebr_t *ebr = ebr_create(ATOR_DEFAULT);
+    pair obj = { 0, 0, 0 }, value = { 1, 2, 3 }, copy;
+    atomic_int number;
+    ator_scratch_t scope;
+    int in = 7, out = 0, ok;
+
+    ok = numa && ring && queue && ebr;
+    if (ok) {
+        void *block = ator_malloc(numa, 64);
+        ok = block != NULL;
+        ator_free(numa, block);
+
+        ok = ok && spsc_try_push(ring, &in) && spsc_try_pop(ring, &out) && out == 7;
+        out = 0;
+        ok = ok && mpmc_try_enqueue(queue, &in) && mpmc_try_dequeue(queue, &out) && out == 7;
+
+        ebr_enter(ebr);
+        ebr_exit(ebr);
+        ebr_retire(ebr, malloc(16), free);
+        ebr_synchronize(ebr);
+
+        atomic_store_n(&obj, &value);
+        atomic_load_n(&obj, &copy);
+        ok = ok && copy.a == 1 && copy.b == 2 && copy.c == 3;
+
+        atomic_init(&number, 0);
+        atomic_int_fetch_add(&number, 5);
+        ok = ok && atomic_int_load(&number) == 5;
+    }
+
+    if (ebr) ebr_destroy(ebr);
+    if (queue) mpmc_destroy(queue);
+    if (ring) spsc_destroy(ring);
+    if (numa) ator_destroy(numa);
+
+    counter_inc(&link_counter);
+    scope = ator_scratch_begin();
+    ator_scratch_end(scope);
+    return ok ? scope.ator : NULL;
+}
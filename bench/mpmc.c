@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Blocking MPMC queue against a mutex and condition variable guarded ring
+ * of the same capacity, for several producer/consumer ratios. Reports
+ * throughput and the mean and worst time a message spent in the queue.
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -D_GNU_SOURCE -iquote .. mpmc.c -o mpmc -lpthread
+ *     ./mpmc [max_threads_per_side] [messages] [capacity]
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "time.h"
+#include "threads.h"
+#include "mpmc.h"
+
+#define MAX_THREADS  64
+
+typedef struct message {
+    double sent;
+} message;
+
+/* The baseline: a ring under one mutex. */
+typedef struct locked_queue {
+    mtx_t lock;
+    cnd_t not_empty;
+    cnd_t not_full;
+    message *ring;
+    size_t capacity;
+    size_t head;
+    size_t count;
+} locked_queue;
+
+typedef struct consumer {
+    unsigned long quota;
+    double latency_sum;
+    double latency_max;
+} consumer;
+
+static nocl_mpmc_t *queue;
+static locked_queue locked;
+static unsigned long per_producer;
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static void locked_enqueue(const message *msg) {
+    mtx_lock(&locked.lock);
+    while (locked.count == locked.capacity) cnd_wait(&locked.not_full, &locked.lock);
+    locked.ring[(locked.head + locked.count ++) % locked.capacity] = *msg;
+    cnd_signal(&locked.not_empty);
+    mtx_unlock(&locked.lock);
+}
+
+static void locked_dequeue(message *msg) {
+    mtx_lock(&locked.lock);
+    while (!locked.count) cnd_wait(&locked.not_empty, &locked.lock);
+    *msg = locked.ring[locked.head];
+    locked.head = (locked.head + 1) % locked.capacity;
+    locked.count --;
+    cnd_signal(&locked.not_full);
+    mtx_unlock(&locked.lock);
+}
+
+static int produce_mpmc(void *arg) {
+    message msg;
+    unsigned long i;
+    (void) arg;
+    for (i = 0; i < per_producer; i ++) {
+        msg.sent = now();
+        mpmc_enqueue(queue, &msg);
+    }
+    return 0;
+}
+
+static int produce_locked(void *arg) {
+    message msg;
+    unsigned long i;
+    (void) arg;
+    for (i = 0; i < per_producer; i ++) {
+        msg.sent = now();
+        locked_enqueue(&msg);
+    }
+    return 0;
+}
+
+static void received(consumer *self, const message *msg) {
+    double latency = now() - msg->sent;
+    self->latency_sum += latency;
+    if (latency > self->latency_max) self->latency_max = latency;
+}
+
+static int consume_mpmc(void *arg) {
+    consumer *self = arg;
+    message msg;
+    unsigned long i;
+    for (i = 0; i < self->quota; i ++) {
+        mpmc_dequeue(queue, &msg);
+        received(self, &msg);
+    }
+    return 0;
+}
+
+static int consume_locked(void *arg) {
+    consumer *self = arg;
+    message msg;
+    unsigned long i;
+    for (i = 0; i < self->quota; i ++) {
+        locked_dequeue(&msg);
+        received(self, &msg);
+    }
+    return 0;
+}
+
+static void run(const char *name, thrd_start_t produce, thrd_start_t consume, int producers, int consumers) {
+    thrd_t thread[2 * MAX_THREADS];
+    consumer state[MAX_THREADS];
+    unsigned long total = per_producer * producers;
+    double start, elapsed, latency_sum = 0, latency_max = 0;
+    int i;
+
+    for (i = 0; i < consumers; i ++) {
+        state[i].quota = total / consumers + ((unsigned long) i < total % consumers);
+        state[i].latency_sum = 0;
+        state[i].latency_max = 0;
+    }
+
+    start = now();
+    for (i = 0; i < consumers; i ++) thrd_create(&thread[i], consume, &state[i]);
+    for (i = 0; i < producers; i ++) thrd_create(&thread[consumers + i], produce, NULL);
+    for (i = 0; i < producers + consumers; i ++) thrd_join(thread[i], NULL);
+    elapsed = now() - start;
+
+    for (i = 0; i < consumers; i ++) {
+        latency_sum += state[i].latency_sum;
+        if (state[i].latency_max > latency_max) latency_max = state[i].latency_max;
+    }
+    printf("%3d:%-3d %-8s %12.2f %14.2f %14.1f\n", producers, consumers, name,
+        (double) total / elapsed / 1e6, latency_sum / (double) total * 1e6, latency_max * 1e6);
+}
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 4;
+    unsigned long messages = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    size_t capacity = argc > 3 ? (size_t) strtoul(argv[3], NULL, 10) : 1024;
+    int producers, consumers;
+
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+    if (!capacity) capacity = 1;
+
+    queue = mpmc_create(sizeof(message), capacity, MPMC_BLOCKING);
+    locked.ring = malloc(capacity * sizeof(message));
+    if (!queue || !locked.ring ||
+        mtx_init(&locked.lock, mtx_plain) != thrd_success ||
+        cnd_init(&locked.not_empty) != thrd_success || cnd_init(&locked.not_full) != thrd_success) {
+        fputs("mpmc: cannot create the queues\n", stderr);
+        return EXIT_FAILURE;
+    }
+    locked.capacity = capacity;
+    locked.head = 0;
+    locked.count = 0;
+
+    printf("%-7s %-8s %12s %14s %14s\n", "P:C", "queue", "Mmsg/s", "mean lat us", "max lat us");
+    for (producers = 1; producers <= max_threads; producers = producers < max_threads && producers * 2 > max_threads ? max_threads : producers * 2) {
+        for (consumers = 1; consumers <= max_threads; consumers = consumers < max_threads && consumers * 2 > max_threads ? max_threads : consumers * 2) {
+            per_producer = messages / producers;
+            run("mpmc", produce_mpmc, consume_mpmc, producers, consumers);
+            run("locked", produce_locked, consume_locked, producers, consumers);
+        }
+    }
+
+    mpmc_destroy(queue);
+    cnd_destroy(&locked.not_full);
+    cnd_destroy(&locked.not_empty);
+    mtx_destroy(&locked.lock);
+    free(locked.ring);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+ * Counter increments under each memory order, from 1 to N threads, on one
+ * shared counter (contended) and on a counter per thread (uncontended).
+ * The 'accessor' column goes through 'atomic_ulong_fetch_add'.
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -iquote .. orders.c -o orders -lpthread
+ *     ./orders [max_threads] [increments_per_thread]
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "time.h"
+#include "threads.h"
+#include "stdatomic.h"
+
+#define MAX_THREADS  256
+#define VARIANTS     4
+
+/* One counter per cache line, so uncontended runs share nothing. */
+typedef union slot {
+    atomic_ulong value;
+    char pad[64];
+} slot;
+
+static slot shared;
+static slot privates[MAX_THREADS];
+static unsigned long iterations = 10000000;
+
+static const char *const names[VARIANTS] = { "relaxed", "acq_rel", "seq_cst", "accessor" };
+
+#define BENCH_ORDER(name,mo) \
+    static int name(void *arg) { \
+        atomic_ulong *counter = &((slot *) arg)->value; \
+        unsigned long i; \
+        for (i = 0; i < iterations; i ++) atomic_fetch_add_explicit(counter, 1, mo); \
+        return 0; \
+    }
+
+BENCH_ORDER(bench_relaxed, memory_order_relaxed)
+BENCH_ORDER(bench_acq_rel, memory_order_acq_rel)
+BENCH_ORDER(bench_seq_cst, memory_order_seq_cst)
+
+static int bench_accessor(void *arg) {
+    atomic_ulong *counter = &((slot *) arg)->value;
+    unsigned long i;
+    for (i = 0; i < iterations; i ++) atomic_ulong_fetch_add(counter, 1);
+    return 0;
+}
+
+static const thrd_start_t funcs[VARIANTS] = { bench_relaxed, bench_acq_rel, bench_seq_cst, bench_accessor };
+
+/* Returns Mops/s, or a negative value if increments were lost. */
+static double run(thrd_start_t func, int threads, int contended) {
+    thrd_t thread[MAX_THREADS];
+    struct timespec start, end;
+    unsigned long total = 0;
+    double seconds;
+    int i;
+
+    atomic_store(&shared.value, 0);
+    for (i = 0; i < threads; i ++) atomic_store(&privates[i].value, 0);
+
+    timespec_get(&start, TIME_UTC);
+    for (i = 0; i < threads; i ++) thrd_create(&thread[i], func, contended ? &shared : &privates[i]);
+    for (i = 0; i < threads; i ++) thrd_join(thread[i], NULL);
+    timespec_get(&end, TIME_UTC);
+
+    if (contended) total = atomic_load(&shared.value);
+    else for (i = 0; i < threads; i ++) total += atomic_load(&privates[i].value);
+    if (total != iterations * threads) return -1;
+
+    seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double) iterations * threads / 1e6 / seconds;
+}
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    int contended, threads, i;
+
+    if (argc > 2) iterations = strtoul(argv[2], NULL, 10);
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+
+    for (contended = 1; contended >= 0; contended --) {
+        printf("%s, Mops/s\n%8s", contended ? "contended" : "uncontended", "threads");
+        for (i = 0; i < VARIANTS; i ++) printf(" %12s", names[i]);
+        putchar('\n');
+
+        for (threads = 1; threads <= max_threads; threads = threads < max_threads && threads * 2 > max_threads ? max_threads : threads * 2) {
+            printf("%8d", threads);
+            for (i = 0; i < VARIANTS; i ++) {
+                double rate = run(funcs[i], threads, contended);
+                if (rate < 0) {
+                    fputs("\norders: lost increments\n", stderr);
+                    return EXIT_FAILURE;
+                }
+                printf(" %12.1f", rate);
+            }
+            putchar('\n');
+        }
+    }
+    return EXIT_SUCCESS;
+}
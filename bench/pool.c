@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Pool allocator against ATOR_DEFAULT (malloc), from 1 to N threads. Each
+ * thread allocates a window of fixed-size objects, frees it, and repeats.
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -iquote .. pool.c -o pool -lpthread
+ *     ./pool [max_threads] [rounds] [object_size]
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+#include "threads.h"
+#include "allocator.h"
+
+#define MAX_THREADS  256
+#define WINDOW       128
+
+static ator_t *bench_ator;
+static unsigned long rounds = 100000;
+static size_t object_size = 64;
+
+static int bench(void *arg) {
+    void *window[WINDOW];
+    unsigned long r;
+    size_t i;
+
+    (void) arg;
+    for (r = 0; r < rounds; r ++) {
+        for (i = 0; i < WINDOW; i ++) {
+            if (!((window[i] = ator_malloc(bench_ator, object_size)))) {
+                fputs("pool: out of memory\n", stderr);
+                exit(EXIT_FAILURE);
+            }
+            *(unsigned char *) window[i] = (unsigned char) i;
+        }
+        for (i = 0; i < WINDOW; i ++) ator_free(bench_ator, window[i]);
+    }
+    return 0;
+}
+
+static double run(ator_t *ator, int threads) {
+    thrd_t thread[MAX_THREADS];
+    struct timespec start, end;
+    int i;
+
+    bench_ator = ator;
+    timespec_get(&start, TIME_UTC);
+    for (i = 0; i < threads; i ++) thrd_create(&thread[i], bench, NULL);
+    for (i = 0; i < threads; i ++) thrd_join(thread[i], NULL);
+    timespec_get(&end, TIME_UTC);
+    return (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    int threads;
+    ator_t *pool;
+
+    if (argc > 2) rounds = strtoul(argv[2], NULL, 10);
+    if (argc > 3) object_size = (size_t) strtoul(argv[3], NULL, 10);
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+    if (!object_size) object_size = 1;
+
+    if (!((pool = ator_create_pool(object_size, 0, ATOR_DEFAULT)))) {
+        fputs("pool: cannot create the pool\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    printf("%zu-byte objects\n", object_size);
+    printf("%8s %16s %16s %8s\n", "threads", "malloc Mops/s", "pool Mops/s", "speedup");
+    for (threads = 1; threads <= max_threads; threads = threads < max_threads && threads * 2 > max_threads ? max_threads : threads * 2) {
+        /* One malloc and one free per object. */
+        double ops = 2.0 * rounds * WINDOW * threads / 1e6;
+        double t_default = run(ATOR_DEFAULT, threads);
+        double t_pool = run(pool, threads);
+        printf("%8d %16.1f %16.1f %7.2fx\n", threads, ops / t_default, ops / t_pool, t_default / t_pool);
+    }
+
+    ator_destroy(pool);
+    return EXIT_SUCCESS;
+}
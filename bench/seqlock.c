@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Reader throughput of a snapshot struct behind a seqlock against one
+ * behind a mtx_t, while a writer updates it at varying rates.
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -iquote .. seqlock.c -o seqlock -lpthread
+ *     ./seqlock [readers] [milliseconds_per_run]
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+#include "threads.h"
+#include "stdatomic.h"
+#include "seqlock.h"
+
+#define MAX_THREADS  256
+
+typedef struct snapshot {
+    unsigned long values[16];
+} snapshot;
+
+static nocl_seqlock_t sl = NOCL_SEQLOCK_INIT;
+static snapshot sl_data;
+static mtx_t lock;
+static snapshot locked_data;
+static atomic_int stop;
+static atomic_int torn;
+static long writer_pause_us;
+static volatile unsigned long sink;  /* Keeps the reads from being optimized away. */
+
+/* Every field of a consistent snapshot holds the same value. */
+static void check(const snapshot *s) {
+    size_t i;
+    for (i = 1; i < 16; i ++) {
+        if (s->values[i] != s->values[0]) {
+            atomic_store(&torn, 1);
+            return;
+        }
+    }
+}
+
+static void fill(snapshot *s, unsigned long value) {
+    size_t i;
+    for (i = 0; i < 16; i ++) s->values[i] = value;
+}
+
+static void pause_writer(void) {
+    struct timespec ts;
+    if (writer_pause_us < 0) return;
+    ts.tv_sec = 0;
+    ts.tv_nsec = writer_pause_us * 1000;
+    thrd_sleep(&ts, NULL);
+}
+
+static int read_seqlock(void *arg) {
+    unsigned long reads = 0;
+    snapshot s = { { 0 } };
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        seqlock_read(&sl, &s, &sl_data, sizeof(snapshot));
+        check(&s);
+        reads ++;
+    }
+    sink = s.values[0];
+    *(unsigned long *) arg = reads;
+    return 0;
+}
+
+static int write_seqlock(void *arg) {
+    unsigned long i;
+    snapshot s;
+    (void) arg;
+    for (i = 1; !atomic_load_explicit(&stop, memory_order_relaxed); i ++) {
+        fill(&s, i);
+        seqlock_write(&sl, &sl_data, &s, sizeof(snapshot));
+        pause_writer();
+    }
+    return 0;
+}
+
+static int read_locked(void *arg) {
+    unsigned long reads = 0;
+    snapshot s = { { 0 } };
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        mtx_lock(&lock);
+        memcpy(&s, &locked_data, sizeof(snapshot));
+        mtx_unlock(&lock);
+        check(&s);
+        reads ++;
+    }
+    sink = s.values[0];
+    *(unsigned long *) arg = reads;
+    return 0;
+}
+
+static int write_locked(void *arg) {
+    unsigned long i;
+    snapshot s;
+    (void) arg;
+    for (i = 1; !atomic_load_explicit(&stop, memory_order_relaxed); i ++) {
+        fill(&s, i);
+        mtx_lock(&lock);
+        memcpy(&locked_data, &s, sizeof(snapshot));
+        mtx_unlock(&lock);
+        pause_writer();
+    }
+    return 0;
+}
+
+static double run(thrd_start_t reader, thrd_start_t writer, int readers, unsigned long ms) {
+    thrd_t thread[MAX_THREADS + 1];
+    unsigned long reads[MAX_THREADS], total = 0;
+    struct timespec ts;
+    int i;
+
+    atomic_store(&stop, 0);
+    for (i = 0; i < readers; i ++) thrd_create(&thread[i], reader, &reads[i]);
+    thrd_create(&thread[readers], writer, NULL);
+    ts.tv_sec = (time_t) (ms / 1000);
+    ts.tv_nsec = (long) (ms % 1000) * 1000000;
+    thrd_sleep(&ts, NULL);
+    atomic_store(&stop, 1);
+    for (i = 0; i <= readers; i ++) thrd_join(thread[i], NULL);
+    for (i = 0; i < readers; i ++) total += reads[i];
+    return (double) total / ((double) ms / 1000);
+}
+
+int main(int argc, char **argv) {
+    /* Pause between writes in microseconds; -1 writes back to back. */
+    static const long pauses[] = { -1, 1, 10, 100, 1000, 10000 };
+    int readers = argc > 1 ? atoi(argv[1]) : 4;
+    unsigned long ms = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+    size_t i;
+
+    if (readers < 1) readers = 1;
+    if (readers > MAX_THREADS) readers = MAX_THREADS;
+    if (mtx_init(&lock, mtx_plain) != thrd_success) {
+        fputs("seqlock: cannot create the mutex\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    printf("%d readers, %zu-byte snapshot\n", readers, sizeof(snapshot));
+    printf("%14s %18s %18s %8s\n", "write pause", "mtx_t Mreads/s", "seqlock Mreads/s", "speedup");
+    for (i = 0; i < sizeof(pauses) / sizeof(pauses[0]); i ++) {
+        double r_locked, r_seqlock;
+        writer_pause_us = pauses[i];
+        r_locked = run(read_locked, write_locked, readers, ms);
+        r_seqlock = run(read_seqlock, write_seqlock, readers, ms);
+        if (pauses[i] < 0) printf("%14s", "none");
+        else printf("%12ldus", pauses[i]);
+        printf(" %18.2f %18.2f %7.2fx\n", r_locked / 1e6, r_seqlock / 1e6, r_seqlock / r_locked);
+    }
+
+    mtx_destroy(&lock);
+    if (atomic_load(&torn)) {
+        fputs("seqlock: a reader saw a torn snapshot\n", stderr);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Cost of allocator dispatch: the same tiny free-list allocator called
+ * through an 'ator_t' and through NOCL_DEFINE_STATIC_ATOR's direct calls.
+ * The allocator is a few instructions, so the difference is the dispatch.
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -iquote .. static_ator.c -o static_ator
+ *     ./static_ator [pairs]
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+#include "allocator.h"
+
+#define OBJECTS      1024
+#define OBJECT_SIZE  32
+
+typedef union node {
+    union node *next;
+    unsigned char data[OBJECT_SIZE];
+} node;
+
+static node objects[OBJECTS];
+static node *free_list;
+
+static void *freelist_malloc(size_t size) {
+    node *res = free_list;
+    if (size > OBJECT_SIZE || !res) return NULL;
+    free_list = res->next;
+    return res;
+}
+
+static void *freelist_calloc(size_t num, size_t size) {
+    void *res = num > 1 ? NULL : freelist_malloc(size);
+    if (res) memset(res, 0, size);
+    return res;
+}
+
+static void *freelist_realloc(void *ptr, size_t size) {
+    return size > OBJECT_SIZE ? NULL : ptr ? ptr : freelist_malloc(size);
+}
+
+static void freelist_free(void *ptr) {
+    node *obj = ptr;
+    if (!obj) return;
+    obj->next = free_list;
+    free_list = obj;
+}
+
+NOCL_DEFINE_STATIC_ATOR(list, freelist_malloc, freelist_calloc, freelist_realloc, freelist_free)
+
+/* Not static, so the compiler cannot see which 'ator_t' it holds. */
+ator_t *bench_ator;
+
+static void reset(void) {
+    size_t i;
+    free_list = NULL;
+    for (i = 0; i < OBJECTS; i ++) freelist_free(&objects[i]);
+}
+
+static double elapsed(const struct timespec *start) {
+    struct timespec end;
+    timespec_get(&end, TIME_UTC);
+    return (double) (end.tv_sec - start->tv_sec) + (double) (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+    unsigned long pairs = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000000;
+    unsigned long i;
+    struct timespec start;
+    double t_dynamic, t_static;
+    void *ptrs[4];
+
+    bench_ator = list_ator();
+
+    reset();
+    timespec_get(&start, TIME_UTC);
+    for (i = 0; i < pairs; i ++) {
+        ptrs[i & 3] = ator_malloc(bench_ator, OBJECT_SIZE);
+        if (i & 1) ator_free(bench_ator, ptrs[(i - 1) & 3]), ator_free(bench_ator, ptrs[i & 3]);
+    }
+    t_dynamic = elapsed(&start);
+
+    reset();
+    timespec_get(&start, TIME_UTC);
+    for (i = 0; i < pairs; i ++) {
+        ptrs[i & 3] = list_malloc(OBJECT_SIZE);
+        if (i & 1) list_free(ptrs[(i - 1) & 3]), list_free(ptrs[i & 3]);
+    }
+    t_static = elapsed(&start);
+
+    printf("ator_t:          %6.2f ns per malloc/free\n", t_dynamic * 1e9 / pairs);
+    printf("static dispatch: %6.2f ns per malloc/free\n", t_static * 1e9 / pairs);
+    printf("speedup:         %6.2fx\n", t_dynamic / t_static);
+    return EXIT_SUCCESS;
+}
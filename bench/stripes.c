@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+ * Generic atomics on a 24-byte struct, which go through the striped seqlock
+ * table, from 1 to N threads: loads of one shared object, compare-exchange
+ * increments of one shared object (one stripe), and compare-exchange
+ * increments of a private object per thread (spread across stripes).
+ *
+ *     cc -std=gnu11 -O2 -fgnu89-inline -iquote .. stripes.c -o stripes -lpthread
+ *     ./stripes [max_threads] [operations_per_thread]
+ */
+
+#include "stddef.h"
+#include "stdlib.h"
+#include "stdio.h"
+#include "time.h"
+#include "threads.h"
+#include "stdatomic.h"
+
+#define MAX_THREADS  256
+
+typedef struct triple {
+    unsigned long a, b, c;
+} triple;
+
+/* One object per cache line, so only the stripes are shared. */
+typedef union slot {
+    triple value;
+    char pad[64];
+} slot;
+
+static triple shared;
+static slot privates[MAX_THREADS];
+static unsigned long iterations = 1000000;
+static volatile unsigned long sink;  /* Keeps the loads from being optimized away. */
+
+static void increment(triple *obj) {
+    triple cur, next;
+    atomic_load_n(obj, &cur);
+    do {
+        next.a = cur.a + 1;
+        next.b = cur.b + 1;
+        next.c = cur.c + 1;
+    } while (!atomic_compare_exchange_n(obj, &cur, &next));
+}
+
+static int bench_load(void *arg) {
+    unsigned long i, sum = 0;
+    triple cur;
+    (void) arg;
+    for (i = 0; i < iterations; i ++) {
+        atomic_load_n(&shared, &cur);
+        sum += cur.a;
+    }
+    sink = sum;
+    return 0;
+}
+
+static int bench_shared(void *arg) {
+    unsigned long i;
+    (void) arg;
+    for (i = 0; i < iterations; i ++) increment(&shared);
+    return 0;
+}
+
+static int bench_private(void *arg) {
+    triple *obj = &((slot *) arg)->value;
+    unsigned long i;
+    for (i = 0; i < iterations; i ++) increment(obj);
+    return 0;
+}
+
+static double run(thrd_start_t func, int threads) {
+    thrd_t thread[MAX_THREADS];
+    struct timespec start, end;
+    int i;
+
+    timespec_get(&start, TIME_UTC);
+    for (i = 0; i < threads; i ++) thrd_create(&thread[i], func, &privates[i]);
+    for (i = 0; i < threads; i ++) thrd_join(thread[i], NULL);
+    timespec_get(&end, TIME_UTC);
+    return (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static int consistent(const triple *obj, unsigned long expected) {
+    return obj->a == expected && obj->b == expected && obj->c == expected;
+}
+
+int main(int argc, char **argv) {
+    static const triple zero = { 0, 0, 0 };
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    int threads, i;
+
+    if (argc > 2) iterations = strtoul(argv[2], NULL, 10);
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+
+    printf("%zu-byte objects, lock-free: %s\n", sizeof(triple), atomic_is_lock_free_n(sizeof(triple), &shared) ? "yes" : "no");
+    printf("%8s %16s %16s %16s\n", "threads", "load Mops/s", "shared Mops/s", "private Mops/s");
+    for (threads = 1; threads <= max_threads; threads = threads < max_threads && threads * 2 > max_threads ? max_threads : threads * 2) {
+        double ops = (double) iterations * threads / 1e6;
+        double t_load, t_shared, t_private;
+
+        atomic_store_n(&shared, &zero);
+        for (i = 0; i < threads; i ++) atomic_store_n(&privates[i].value, &zero);
+        t_load = run(bench_load, threads);
+        t_shared = run(bench_shared, threads);
+        t_private = run(bench_private, threads);
+
+        if (!consistent(&shared, iterations * threads)) {
+            fputs("stripes: lost or torn shared updates\n", stderr);
+            return EXIT_FAILURE;
+        }
+        for (i = 0; i < threads; i ++) {
+            if (!consistent(&privates[i].value, iterations)) {
+                fputs("stripes: lost or torn private updates\n", stderr);
+                return EXIT_FAILURE;
+            }
+        }
+        printf("%8d %16.1f %16.1f %16.1f\n", threads, ops / t_load, ops / t_shared, ops / t_private);
+    }
+    return EXIT_SUCCESS;
+}
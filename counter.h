@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2015 Nick Strupat
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#if !defined(_NOCL_COUNTER_H)
+#define _NOCL_COUNTER_H
+
+#if defined(__cplusplus)
+
+extern "C" {
+
+#endif
+
+#include "stddef.h"
+#include "inttypes.h"
+#include "stdalign.h"
+#include "inline.h"
+#include "callconv.h"
+#include "threads.h"
+#include "stdatomic.h"
+#include "selectany.h"
+
+/*
+ * Sharded counters.
+ *
+ * A 'nocl_counter_t' spreads its value over cache-line sized shards, so
+ * threads incrementing it from different cores do not fight over a single
+ * line. 'counter_add' is one relaxed increment of the current CPU's shard
+ * (or, where the CPU is unknown, a shard fixed per thread), and
+ * 'counter_read' sums all shards. Reads are not a snapshot: increments
+ * racing with a read may or may not be counted, but none is ever lost.
+ */
+
+#if defined(NOCL_FEATURE_NO_STDATOMIC) || defined(NOCL_FEATURE_NO_STDALIGN)
+
+#define NOCL_FEATURE_NO_COUNTER
+
+#else
+
+#if !defined(NOCL_COUNTER_SHARDS)
+
+#define NOCL_COUNTER_SHARDS  64
+
+#endif
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+#define __NOCL_INTERNAL_COUNTER_HAS_CPU
+
+#elif defined(__linux__) && defined(_GNU_SOURCE)
+
+#include <sched.h>
+
+#define __NOCL_INTERNAL_COUNTER_HAS_CPU
+
+#endif
+
+struct __nocl_internal_counter_shard {
+    alignas(64) atomic_ullong value;
+};
+
+typedef struct nocl_counter {
+    struct __nocl_internal_counter_shard shards[NOCL_COUNTER_SHARDS];
+} nocl_counter_t;
+
+#define NOCL_COUNTER_INIT  { { { 0 } } }
+
+#if defined(thread_local)
+
+_Selectany thread_local unsigned int __nocl_internal_counter_thread_shard = 0;
+_Selectany atomic_uint __nocl_internal_counter_next_shard = 0;
+
+/* Hand out shards round-robin, once per thread; 0 means not assigned yet. */
+static inline unsigned int cdecl __nocl_internal_counter_thread(void) {
+    unsigned int shard = __nocl_internal_counter_thread_shard;
+    if (!shard) {
+        shard = atomic_fetch_add_explicit(&__nocl_internal_counter_next_shard, 1, memory_order_relaxed) % NOCL_COUNTER_SHARDS + 1;
+        __nocl_internal_counter_thread_shard = shard;
+    }
+    return shard - 1;
+}
+
+#else
+
+static inline unsigned int cdecl __nocl_internal_counter_thread(void) {
+    return 0;
+}
+
+#endif
+
+static inline unsigned int cdecl __nocl_internal_counter_shard(void) {
+
+#if defined(_WIN32)
+
+    return (unsigned int) GetCurrentProcessorNumber() % NOCL_COUNTER_SHARDS;
+
+#elif defined(__NOCL_INTERNAL_COUNTER_HAS_CPU)
+
+    /* Reads the CPU from rseq or the vDSO; a migration only costs a shared line. */
+    int cpu = sched_getcpu();
+    if (cpu >= 0) return (unsigned int) cpu % NOCL_COUNTER_SHARDS;
+    return __nocl_internal_counter_thread();
+
+#else
+
+    return __nocl_internal_counter_thread();
+
+#endif
+
+}
+
+static inline void cdecl counter_init(nocl_counter_t *counter) {
+    size_t i;
+    for (i = 0; i < NOCL_COUNTER_SHARDS; i ++)
+        atomic_store_explicit(&counter->shards[i].value, 0, memory_order_relaxed);
+}
+
+static inline void cdecl counter_add(nocl_counter_t *counter, unsigned long long n) {
+    atomic_fetch_add_explicit(&counter->shards[__nocl_internal_counter_shard()].value, n, memory_order_relaxed);
+}
+
+static inline void cdecl counter_sub(nocl_counter_t *counter, unsigned long long n) {
+    atomic_fetch_sub_explicit(&counter->shards[__nocl_internal_counter_shard()].value, n, memory_order_relaxed);
+}
+
+#define counter_inc(counter)  counter_add((counter), 1)
+#define counter_dec(counter)  counter_sub((counter), 1)
+
+/* Shards wrap independently, so the sum is right modulo 2^64 even after 'counter_sub'. */
+static inline unsigned long long cdecl counter_read(nocl_counter_t *counter) {
+    unsigned long long sum = 0;
+    size_t i;
+    for (i = 0; i < NOCL_COUNTER_SHARDS; i ++)
+        sum += atomic_load_explicit(&counter->shards[i].value, memory_order_relaxed);
+    return sum;
+}
+
+/* Zero the counter and return what it held; nothing added concurrently is lost. */
+static inline unsigned long long cdecl counter_reset(nocl_counter_t *counter) {
+    unsigned long long sum = 0;
+    size_t i;
+    for (i = 0; i < NOCL_COUNTER_SHARDS; i ++)
+        sum += atomic_exchange_explicit(&counter->shards[i].value, 0, memory_order_relaxed);
+    return sum;
+}
+
+#endif
+
+#if defined(__cplusplus)
+
+}
+
+#endif
+
+#endif
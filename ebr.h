@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2015 Nick Strupat
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#if !defined(_NOCL_EBR_H)
+#define _NOCL_EBR_H
+
+#if defined(__cplusplus)
+
+extern "C" {
+
+#endif
+
+#include "stddef.h"
+#include "stdbool.h"
+#include "stdlib.h"
+#include "string.h"
+#include "inline.h"
+#include "callconv.h"
+#include "threads.h"
+#include "stdatomic.h"
+#include "allocator.h"
+
+/*
+ * Epoch-based reclamation.
+ *
+ * Readers bracket their accesses to shared nodes with 'ebr_enter' and
+ * 'ebr_exit'. A node unlinked from the structure is handed to 'ebr_retire'
+ * and freed once every reader that might still see it has left: a retired
+ * node is tagged with the global epoch, the epoch only advances when all
+ * active readers have observed the current one, and a node tagged 'e' is
+ * freed once the epoch reaches 'e + 2'.
+ *
+ * Each thread gets a record on first use through a 'tss_t', so entering a
+ * critical section is one relaxed load of the global epoch and one store
+ * to the thread's own record. On Linux the matching store-load barrier is
+ * paid by the reclaimer through membarrier(2) where the kernel supports
+ * it; elsewhere readers issue a full fence.
+ *
+ * Retired nodes are freed in batches, by their own 'ebr_free_t' or, given
+ * none, through 'ator_free_batch' on the domain's allocator. A thread that
+ * exits leaves its record, and any garbage in it, to the next thread that
+ * registers; 'ebr_destroy' frees whatever is left.
+ */
+
+#if defined(NOCL_FEATURE_NO_ALLOCATOR) || defined(NOCL_FEATURE_NO_THREADS) || defined(NOCL_FEATURE_NO_STDATOMIC)
+
+#define NOCL_FEATURE_NO_EBR
+
+#else
+
+#if !defined(NOCL_EBR_BATCH)
+
+#define NOCL_EBR_BATCH  64
+
+#endif
+
+#if defined(__linux__)
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#if defined(SYS_membarrier) && \
+    (defined(_GNU_SOURCE) || defined(_DEFAULT_SOURCE) || defined(_BSD_SOURCE) || defined(__USE_MISC))
+
+#define __NOCL_INTERNAL_EBR_HAS_MEMBARRIER
+
+#endif
+
+#endif
+
+#define __NOCL_INTERNAL_EBR_MEMBARRIER_QUERY                     0
+#define __NOCL_INTERNAL_EBR_MEMBARRIER_PRIVATE_EXPEDITED           8
+#define __NOCL_INTERNAL_EBR_MEMBARRIER_REGISTER_PRIVATE_EXPEDITED  16
+
+typedef void (*ebr_free_t)(void *);
+
+typedef struct __nocl_internal_ebr_bag {
+    size_t epoch;
+    size_t count;
+    size_t capacity;
+    void **ptrs;
+    ebr_free_t *fns;
+} __nocl_internal_ebr_bag;
+
+typedef struct __nocl_internal_ebr_record {
+    /* Written by the owner on every enter and exit; '(epoch << 1) | 1' while active. */
+    atomic_size_t local;
+    char pad[64];
+
+    struct nocl_ebr *ebr;
+    struct __nocl_internal_ebr_record *next;
+    atomic_int owned;
+    size_t depth;
+    size_t pending;
+    __nocl_internal_ebr_bag bags[3];
+} __nocl_internal_ebr_record;
+
+typedef struct nocl_ebr {
+    atomic_size_t epoch;
+    char pad[64];
+
+    ator_t *ator;
+    tss_t key;
+    int membarrier;
+    __nocl_internal_ebr_record *_Atomic records;
+} nocl_ebr_t;
+
+/* Make every reader's record store visible before the caller looks at records. */
+static inline void cdecl __nocl_internal_ebr_heavy_fence(nocl_ebr_t *ebr) {
+
+#if defined(__NOCL_INTERNAL_EBR_HAS_MEMBARRIER)
+
+    if (ebr->membarrier && !syscall(SYS_membarrier, __NOCL_INTERNAL_EBR_MEMBARRIER_PRIVATE_EXPEDITED, 0)) return;
+
+#else
+
+    (void) ebr;
+
+#endif
+
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+/* Free everything in 'bag'; custom free functions first, the rest as one batch. */
+static inline void cdecl __nocl_internal_ebr_drain(nocl_ebr_t *ebr, __nocl_internal_ebr_bag *bag) {
+    size_t i, n = 0;
+    for (i = 0; i < bag->count; i ++) {
+        if (bag->fns[i]) bag->fns[i](bag->ptrs[i]);
+        else bag->ptrs[n ++] = bag->ptrs[i];
+    }
+    if (n) ator_free_batch(ebr->ator, bag->ptrs, n);
+    bag->count = 0;
+}
+
+/* Try to move the global epoch on by one; fails while a reader lags behind. */
+static inline bool cdecl __nocl_internal_ebr_advance(nocl_ebr_t *ebr) {
+    size_t epoch = atomic_load_explicit(&ebr->epoch, memory_order_seq_cst);
+    __nocl_internal_ebr_record *rec;
+    size_t local;
+
+    __nocl_internal_ebr_heavy_fence(ebr);
+    for (rec = atomic_load_explicit(&ebr->records, memory_order_acquire); rec; rec = rec->next) {
+        local = atomic_load_explicit(&rec->local, memory_order_acquire);
+        if ((local & 1) && (local >> 1) != epoch) return false;
+    }
+    return atomic_compare_exchange_strong_explicit(&ebr->epoch, &epoch, epoch + 1, memory_order_seq_cst, memory_order_relaxed) ||
+        epoch != atomic_load_explicit(&ebr->epoch, memory_order_relaxed);
+}
+
+static inline void cdecl __nocl_internal_ebr_collect(nocl_ebr_t *ebr, __nocl_internal_ebr_record *rec) {
+    size_t epoch, i;
+
+    __nocl_internal_ebr_advance(ebr);
+    epoch = atomic_load_explicit(&ebr->epoch, memory_order_acquire);
+    for (i = 0; i < 3; i ++) {
+        if (rec->bags[i].count && rec->bags[i].epoch + 2 <= epoch) {
+            rec->pending -= rec->bags[i].count;
+            __nocl_internal_ebr_drain(ebr, &rec->bags[i]);
+        }
+    }
+}
+
+static inline void cdecl __nocl_internal_ebr_release(void *arg) {
+    __nocl_internal_ebr_record *rec = arg;
+    if (rec->pending) __nocl_internal_ebr_collect(rec->ebr, rec);
+    atomic_store_explicit(&rec->owned, 0, memory_order_release);
+}
+
+static inline __nocl_internal_ebr_record *cdecl __nocl_internal_ebr_register(nocl_ebr_t *ebr) {
+    __nocl_internal_ebr_record *rec;
+    int expected;
+
+    for (rec = atomic_load_explicit(&ebr->records, memory_order_acquire); rec; rec = rec->next) {
+        expected = 0;
+        if (!atomic_load_explicit(&rec->owned, memory_order_relaxed) &&
+            atomic_compare_exchange_strong_explicit(&rec->owned, &expected, 1, memory_order_acquire, memory_order_relaxed)) break;
+    }
+
+    if (!rec) {
+        rec = aligned_malloc(sizeof(__nocl_internal_ebr_record), 64);
+        if (!rec) return NULL;
+        memset(rec, 0, sizeof(__nocl_internal_ebr_record));
+        rec->ebr = ebr;
+        atomic_store_explicit(&rec->local, 0, memory_order_relaxed);
+        atomic_store_explicit(&rec->owned, 1, memory_order_relaxed);
+        rec->next = atomic_load_explicit(&ebr->records, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&ebr->records, &rec->next, rec, memory_order_release, memory_order_relaxed));
+    }
+
+    if (tss_set(ebr->key, rec) != thrd_success) {
+        atomic_store_explicit(&rec->owned, 0, memory_order_release);
+        return NULL;
+    }
+    return rec;
+}
+
+static inline __nocl_internal_ebr_record *cdecl __nocl_internal_ebr_self(nocl_ebr_t *ebr) {
+    __nocl_internal_ebr_record *rec = tss_get(ebr->key);
+    return rec ? rec : __nocl_internal_ebr_register(ebr);
+}
+
+/* 'ator' receives retired nodes that have no free function of their own; NULL means 'free'. */
+static inline nocl_ebr_t *cdecl ebr_create(ator_t *ator) {
+    nocl_ebr_t *ebr = aligned_malloc(sizeof(nocl_ebr_t), 64);
+    if (!ebr) return NULL;
+
+    if (tss_create(&ebr->key, __nocl_internal_ebr_release) != thrd_success) {
+        aligned_free(ebr);
+        return NULL;
+    }
+    ebr->ator = ator;
+    ebr->membarrier = 0;
+    atomic_store_explicit(&ebr->epoch, 0, memory_order_relaxed);
+    atomic_store_explicit(&ebr->records, NULL, memory_order_release);
+
+#if defined(__NOCL_INTERNAL_EBR_HAS_MEMBARRIER)
+
+    {
+        long cmds = syscall(SYS_membarrier, __NOCL_INTERNAL_EBR_MEMBARRIER_QUERY, 0);
+        if (cmds > 0 && (cmds & __NOCL_INTERNAL_EBR_MEMBARRIER_PRIVATE_EXPEDITED) &&
+            !syscall(SYS_membarrier, __NOCL_INTERNAL_EBR_MEMBARRIER_REGISTER_PRIVATE_EXPEDITED, 0))
+            ebr->membarrier = 1;
+    }
+
+#endif
+
+    return ebr;
+}
+
+/* Frees all remaining garbage; no thread may be inside or use 'ebr' any more. */
+static inline void cdecl ebr_destroy(nocl_ebr_t *ebr) {
+    __nocl_internal_ebr_record *rec, *next;
+    size_t i;
+
+    if (!ebr) return;
+    tss_delete(ebr->key);
+    for (rec = atomic_load_explicit(&ebr->records, memory_order_acquire); rec; rec = next) {
+        next = rec->next;
+        for (i = 0; i < 3; i ++) {
+            __nocl_internal_ebr_drain(ebr, &rec->bags[i]);
+            free(rec->bags[i].ptrs);
+            free(rec->bags[i].fns);
+        }
+        aligned_free(rec);
+    }
+    aligned_free(ebr);
+}
+
+/* Critical sections nest; returns false only if the thread could not be registered. */
+static inline bool cdecl ebr_enter(nocl_ebr_t *ebr) {
+    __nocl_internal_ebr_record *rec = __nocl_internal_ebr_self(ebr);
+    if (!rec) return false;
+    if (rec->depth ++) return true;
+
+    atomic_store_explicit(&rec->local, (atomic_load_explicit(&ebr->epoch, memory_order_relaxed) << 1) | 1, memory_order_relaxed);
+    if (ebr->membarrier) atomic_signal_fence(memory_order_seq_cst);
+    else atomic_thread_fence(memory_order_seq_cst);
+    return true;
+}
+
+static inline void cdecl ebr_exit(nocl_ebr_t *ebr) {
+    __nocl_internal_ebr_record *rec = tss_get(ebr->key);
+    if (-- rec->depth) return;
+    atomic_store_explicit(&rec->local, 0, memory_order_release);
+}
+
+/*
+ * Free 'ptr' with 'fn' (or the domain's allocator if NULL) once no reader
+ * can hold it. 'ptr' must already be unreachable for new readers. If the
+ * thread cannot be registered or the limbo list cannot grow, waits for a
+ * grace period and frees 'ptr' on the spot instead. Called inside a
+ * critical section, that wait leaves the section and enters it again, so
+ * nodes read before the call must not be used after it.
+ */
+static inline void cdecl ebr_retire(nocl_ebr_t *ebr, void *ptr, ebr_free_t fn) {
+    __nocl_internal_ebr_record *rec = __nocl_internal_ebr_self(ebr);
+    __nocl_internal_ebr_bag *bag;
+    size_t epoch, capacity;
+    void **ptrs;
+    ebr_free_t *fns;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    epoch = atomic_load_explicit(&ebr->epoch, memory_order_seq_cst);
+
+    if (rec) {
+        bag = &rec->bags[epoch % 3];
+        /* Left over from three or more epochs ago, so safe by now. */
+        if (bag->count && bag->epoch != epoch) {
+            rec->pending -= bag->count;
+            __nocl_internal_ebr_drain(ebr, bag);
+        }
+        bag->epoch = epoch;
+
+        if (bag->count == bag->capacity) {
+            capacity = bag->capacity ? bag->capacity * 2 : NOCL_EBR_BATCH;
+            ptrs = realloc(bag->ptrs, capacity * sizeof(void *));
+            if (ptrs) bag->ptrs = ptrs;
+            fns = ptrs ? realloc(bag->fns, capacity * sizeof(ebr_free_t)) : NULL;
+            if (fns) {
+                bag->fns = fns;
+                bag->capacity = capacity;
+            }
+        }
+
+        if (bag->count < bag->capacity) {
+            bag->ptrs[bag->count] = ptr;
+            bag->fns[bag->count ++] = fn;
+            if (++ rec->pending >= NOCL_EBR_BATCH) __nocl_internal_ebr_collect(ebr, rec);
+            return;
+        }
+    }
+
+    /* The epoch cannot pass one this thread still pins, so stop pinning it while waiting. */
+    if (rec && rec->depth) atomic_store_explicit(&rec->local, 0, memory_order_release);
+    while (atomic_load_explicit(&ebr->epoch, memory_order_acquire) < epoch + 2) {
+        if (!__nocl_internal_ebr_advance(ebr)) thrd_yield();
+    }
+    if (rec && rec->depth) {
+        atomic_store_explicit(&rec->local, (atomic_load_explicit(&ebr->epoch, memory_order_relaxed) << 1) | 1, memory_order_relaxed);
+        if (ebr->membarrier) atomic_signal_fence(memory_order_seq_cst);
+        else atomic_thread_fence(memory_order_seq_cst);
+    }
+    if (fn) fn(ptr);
+    else ator_free(ebr->ator, ptr);
+}
+
+/* Wait until everything the calling thread retired so far is freed. Not inside a critical section. */
+static inline void cdecl ebr_synchronize(nocl_ebr_t *ebr) {
+    __nocl_internal_ebr_record *rec = __nocl_internal_ebr_self(ebr);
+    size_t target = atomic_load_explicit(&ebr->epoch, memory_order_seq_cst) + 2;
+
+    while (atomic_load_explicit(&ebr->epoch, memory_order_acquire) < target) {
+        if (!__nocl_internal_ebr_advance(ebr)) thrd_yield();
+    }
+    if (rec && rec->pending) __nocl_internal_ebr_collect(ebr, rec);
+}
+
+#endif
+
+#if defined(__cplusplus)
+
+}
+
+#endif
+
+#endif
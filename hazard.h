@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2015 Nick Strupat
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#if !defined(_NOCL_HAZARD_H)
+#define _NOCL_HAZARD_H
+
+#if defined(__cplusplus)
+
+extern "C" {
+
+#endif
+
+#include "stddef.h"
+#include "stdbool.h"
+#include "stdlib.h"
+#include "string.h"
+#include "inline.h"
+#include "callconv.h"
+#include "threads.h"
+#include "stdatomic.h"
+#include "allocator.h"
+
+/*
+ * Hazard pointers.
+ *
+ * A reader publishes the node it is about to dereference in one of its
+ * NOCL_HP_SLOTS slots with 'hp_protect', which rereads the source until
+ * the published pointer is known to have still been reachable. Retired
+ * nodes are freed by a scan that skips everything found in any slot, so
+ * a reader can hold a node as long as it likes without holding up the
+ * reclamation of anything else.
+ *
+ * Scans are amortized: a thread scans once it has retired more than
+ * '2 * H + NOCL_HP_BATCH' nodes, where H is the number of slots of all
+ * registered threads. A scan keeps at most H nodes, so each one frees at
+ * least 'H + NOCL_HP_BATCH', and a thread never holds more than
+ * '2 * H + NOCL_HP_BATCH' retired nodes.
+ *
+ * Thread records are registered on first use through a 'tss_t' and passed
+ * on to the next thread when their owner exits, together with whatever is
+ * still protected at that point; 'hp_destroy' frees the rest. As with
+ * ebr.h, the store-load barrier in 'hp_protect' is moved to the scanning
+ * thread through membarrier(2) where Linux supports it.
+ */
+
+#if defined(NOCL_FEATURE_NO_ALLOCATOR) || defined(NOCL_FEATURE_NO_THREADS) || defined(NOCL_FEATURE_NO_STDATOMIC)
+
+#define NOCL_FEATURE_NO_HAZARD
+
+#else
+
+#if !defined(NOCL_HP_SLOTS)
+
+#define NOCL_HP_SLOTS  4
+
+#endif
+
+#if !defined(NOCL_HP_BATCH)
+
+#define NOCL_HP_BATCH  64
+
+#endif
+
+#if defined(__linux__)
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#if defined(SYS_membarrier) && \
+    (defined(_GNU_SOURCE) || defined(_DEFAULT_SOURCE) || defined(_BSD_SOURCE) || defined(__USE_MISC))
+
+#define __NOCL_INTERNAL_HAZARD_HAS_MEMBARRIER
+
+#endif
+
+#endif
+
+#define __NOCL_INTERNAL_HAZARD_MEMBARRIER_QUERY                     0
+#define __NOCL_INTERNAL_HAZARD_MEMBARRIER_PRIVATE_EXPEDITED           8
+#define __NOCL_INTERNAL_HAZARD_MEMBARRIER_REGISTER_PRIVATE_EXPEDITED  16
+
+typedef void (*hp_free_t)(void *);
+
+typedef struct __nocl_internal_hazard_record {
+    /* Written by the owner, read by every scan. */
+    void *_Atomic slots[NOCL_HP_SLOTS];
+    char pad[64];
+
+    struct nocl_hp *hp;
+    struct __nocl_internal_hazard_record *next;
+    atomic_int owned;
+    size_t count;
+    size_t capacity;
+    void **ptrs;
+    hp_free_t *fns;
+    size_t seen_capacity;
+    void **seen;
+} __nocl_internal_hazard_record;
+
+typedef struct nocl_hp {
+    __nocl_internal_hazard_record *_Atomic records;
+    atomic_size_t record_count;
+    ator_t *ator;
+    tss_t key;
+    int membarrier;
+} nocl_hp_t;
+
+static inline void cdecl __nocl_internal_hazard_heavy_fence(nocl_hp_t *hp) {
+
+#if defined(__NOCL_INTERNAL_HAZARD_HAS_MEMBARRIER)
+
+    if (hp->membarrier && !syscall(SYS_membarrier, __NOCL_INTERNAL_HAZARD_MEMBARRIER_PRIVATE_EXPEDITED, 0)) return;
+
+#else
+
+    (void) hp;
+
+#endif
+
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+static inline int cdecl __nocl_internal_hazard_compare(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t) *(void *const *) a, y = (uintptr_t) *(void *const *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* Free every retired node of 'rec' that no slot holds. */
+static inline void cdecl __nocl_internal_hazard_scan(nocl_hp_t *hp, __nocl_internal_hazard_record *rec) {
+    __nocl_internal_hazard_record *other;
+    size_t seen = 0, kept = 0, freed = 0, i, total;
+    void **grown;
+    void *ptr;
+    hp_free_t fn;
+    int j;
+
+    __nocl_internal_hazard_heavy_fence(hp);
+    for (other = atomic_load_explicit(&hp->records, memory_order_acquire); other; other = other->next) {
+        /* Threads may register meanwhile; a scan that cannot see every slot frees nothing. */
+        if (rec->seen_capacity - seen < NOCL_HP_SLOTS) {
+            total = atomic_load_explicit(&hp->record_count, memory_order_acquire) * NOCL_HP_SLOTS;
+            if (total < seen + NOCL_HP_SLOTS) total = seen + NOCL_HP_SLOTS;
+            grown = realloc(rec->seen, total * sizeof(void *));
+            if (!grown) return;
+            rec->seen = grown;
+            rec->seen_capacity = total;
+        }
+        for (j = 0; j < NOCL_HP_SLOTS; j ++) {
+            if ((ptr = atomic_load_explicit(&other->slots[j], memory_order_acquire))) rec->seen[seen ++] = ptr;
+        }
+    }
+    qsort(rec->seen, seen, sizeof(void *), __nocl_internal_hazard_compare);
+
+    /* Move what is still protected to the front... */
+    for (i = 0; i < rec->count; i ++) {
+        ptr = rec->ptrs[i];
+        if (seen && bsearch(&ptr, rec->seen, seen, sizeof(void *), __nocl_internal_hazard_compare)) {
+            fn = rec->fns[i];
+            rec->ptrs[i] = rec->ptrs[kept];
+            rec->fns[i] = rec->fns[kept];
+            rec->ptrs[kept] = ptr;
+            rec->fns[kept ++] = fn;
+        }
+    }
+
+    /* ...and free the rest, handing those without a free function to the allocator at once. */
+    for (i = kept; i < rec->count; i ++) {
+        if (rec->fns[i]) rec->fns[i](rec->ptrs[i]);
+        else rec->ptrs[kept + freed ++] = rec->ptrs[i];
+    }
+    if (freed) ator_free_batch(hp->ator, rec->ptrs + kept, freed);
+    rec->count = kept;
+}
+
+static inline void cdecl __nocl_internal_hazard_release(void *arg) {
+    __nocl_internal_hazard_record *rec = arg;
+    int i;
+    for (i = 0; i < NOCL_HP_SLOTS; i ++)
+        atomic_store_explicit(&rec->slots[i], NULL, memory_order_release);
+    if (rec->count) __nocl_internal_hazard_scan(rec->hp, rec);
+    atomic_store_explicit(&rec->owned, 0, memory_order_release);
+}
+
+static inline __nocl_internal_hazard_record *cdecl __nocl_internal_hazard_register(nocl_hp_t *hp) {
+    __nocl_internal_hazard_record *rec;
+    int expected, i;
+
+    for (rec = atomic_load_explicit(&hp->records, memory_order_acquire); rec; rec = rec->next) {
+        expected = 0;
+        if (!atomic_load_explicit(&rec->owned, memory_order_relaxed) &&
+            atomic_compare_exchange_strong_explicit(&rec->owned, &expected, 1, memory_order_acquire, memory_order_relaxed)) break;
+    }
+
+    if (!rec) {
+        rec = aligned_malloc(sizeof(__nocl_internal_hazard_record), 64);
+        if (!rec) return NULL;
+        memset(rec, 0, sizeof(__nocl_internal_hazard_record));
+        rec->hp = hp;
+        for (i = 0; i < NOCL_HP_SLOTS; i ++)
+            atomic_store_explicit(&rec->slots[i], NULL, memory_order_relaxed);
+        atomic_store_explicit(&rec->owned, 1, memory_order_relaxed);
+        rec->next = atomic_load_explicit(&hp->records, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&hp->records, &rec->next, rec, memory_order_release, memory_order_relaxed));
+        atomic_fetch_add_explicit(&hp->record_count, 1, memory_order_release);
+    }
+
+    if (tss_set(hp->key, rec) != thrd_success) {
+        atomic_store_explicit(&rec->owned, 0, memory_order_release);
+        return NULL;
+    }
+    return rec;
+}
+
+static inline __nocl_internal_hazard_record *cdecl __nocl_internal_hazard_self(nocl_hp_t *hp) {
+    __nocl_internal_hazard_record *rec = tss_get(hp->key);
+    return rec ? rec : __nocl_internal_hazard_register(hp);
+}
+
+/* 'ator' receives retired nodes that have no free function of their own; NULL means 'free'. */
+static inline nocl_hp_t *cdecl hp_create(ator_t *ator) {
+    nocl_hp_t *hp = malloc(sizeof(nocl_hp_t));
+    if (!hp) return NULL;
+
+    if (tss_create(&hp->key, __nocl_internal_hazard_release) != thrd_success) {
+        free(hp);
+        return NULL;
+    }
+    hp->ator = ator;
+    hp->membarrier = 0;
+    atomic_store_explicit(&hp->record_count, 0, memory_order_relaxed);
+    atomic_store_explicit(&hp->records, NULL, memory_order_release);
+
+#if defined(__NOCL_INTERNAL_HAZARD_HAS_MEMBARRIER)
+
+    {
+        long cmds = syscall(SYS_membarrier, __NOCL_INTERNAL_HAZARD_MEMBARRIER_QUERY, 0);
+        if (cmds > 0 && (cmds & __NOCL_INTERNAL_HAZARD_MEMBARRIER_PRIVATE_EXPEDITED) &&
+            !syscall(SYS_membarrier, __NOCL_INTERNAL_HAZARD_MEMBARRIER_REGISTER_PRIVATE_EXPEDITED, 0))
+            hp->membarrier = 1;
+    }
+
+#endif
+
+    return hp;
+}
+
+/* Frees all retired nodes; no thread may use 'hp' any more. */
+static inline void cdecl hp_destroy(nocl_hp_t *hp) {
+    __nocl_internal_hazard_record *rec, *next;
+    size_t i, n;
+
+    if (!hp) return;
+    tss_delete(hp->key);
+    for (rec = atomic_load_explicit(&hp->records, memory_order_acquire); rec; rec = next) {
+        next = rec->next;
+        for (i = 0, n = 0; i < rec->count; i ++) {
+            if (rec->fns[i]) rec->fns[i](rec->ptrs[i]);
+            else rec->ptrs[n ++] = rec->ptrs[i];
+        }
+        if (n) ator_free_batch(hp->ator, rec->ptrs, n);
+        free(rec->ptrs);
+        free(rec->fns);
+        free(rec->seen);
+        aligned_free(rec);
+    }
+    free(hp);
+}
+
+/*
+ * Load the pointer in '*src' and protect it in 'slot' (0 to NOCL_HP_SLOTS - 1)
+ * until that slot is cleared or reused. Returns NULL, with nothing
+ * protected, if the thread could not be registered.
+ */
+static inline void *cdecl __nocl_internal_hazard_protect(nocl_hp_t *hp, int slot, void *_Atomic *src) {
+    __nocl_internal_hazard_record *rec = __nocl_internal_hazard_self(hp);
+    void *ptr, *again;
+
+    if (!rec) return NULL;
+    ptr = atomic_load_explicit(src, memory_order_relaxed);
+    for (;;) {
+        atomic_store_explicit(&rec->slots[slot], ptr, memory_order_relaxed);
+        if (hp->membarrier) atomic_signal_fence(memory_order_seq_cst);
+        else atomic_thread_fence(memory_order_seq_cst);
+        again = atomic_load_explicit(src, memory_order_acquire);
+        if (again == ptr) return ptr;
+        ptr = again;
+    }
+}
+
+#define hp_protect(hp,slot,src)  __nocl_internal_hazard_protect((hp), (slot), (void *_Atomic *) (src))
+
+static inline void cdecl hp_clear(nocl_hp_t *hp, int slot) {
+    __nocl_internal_hazard_record *rec = tss_get(hp->key);
+    if (rec) atomic_store_explicit(&rec->slots[slot], NULL, memory_order_release);
+}
+
+/*
+ * Free 'ptr' with 'fn' (or the domain's allocator if NULL) once no slot
+ * holds it. 'ptr' must already be unreachable from the structure. If the
+ * retired list cannot grow, scans first and, failing that, waits for
+ * 'ptr' to become unprotected and frees it directly.
+ */
+static inline void cdecl hp_retire(nocl_hp_t *hp, void *ptr, hp_free_t fn) {
+    __nocl_internal_hazard_record *rec = __nocl_internal_hazard_self(hp), *other;
+    size_t capacity, limit;
+    void **ptrs;
+    hp_free_t *fns;
+    int busy, j;
+
+    if (rec) {
+        if (rec->count == rec->capacity) {
+            capacity = rec->capacity ? rec->capacity * 2 : NOCL_HP_BATCH;
+            ptrs = realloc(rec->ptrs, capacity * sizeof(void *));
+            if (ptrs) rec->ptrs = ptrs;
+            fns = ptrs ? realloc(rec->fns, capacity * sizeof(hp_free_t)) : NULL;
+            if (fns) {
+                rec->fns = fns;
+                rec->capacity = capacity;
+            }
+            else __nocl_internal_hazard_scan(hp, rec);
+        }
+
+        if (rec->count < rec->capacity) {
+            rec->ptrs[rec->count] = ptr;
+            rec->fns[rec->count ++] = fn;
+            limit = 2 * atomic_load_explicit(&hp->record_count, memory_order_relaxed) * NOCL_HP_SLOTS + NOCL_HP_BATCH;
+            if (rec->count >= limit) __nocl_internal_hazard_scan(hp, rec);
+            return;
+        }
+    }
+
+    do {
+        busy = 0;
+        __nocl_internal_hazard_heavy_fence(hp);
+        for (other = atomic_load_explicit(&hp->records, memory_order_acquire); other && !busy; other = other->next) {
+            for (j = 0; j < NOCL_HP_SLOTS; j ++) {
+                if (atomic_load_explicit(&other->slots[j], memory_order_acquire) == ptr) busy = 1;
+            }
+        }
+        if (busy) thrd_yield();
+    } while (busy);
+    if (fn) fn(ptr);
+    else ator_free(hp->ator, ptr);
+}
+
+#endif
+
+#if defined(__cplusplus)
+
+}
+
+#endif
+
+#endif
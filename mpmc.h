@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2015 Nick Strupat
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#if !defined(_NOCL_MPMC_H)
+#define _NOCL_MPMC_H
+
+#if defined(__cplusplus)
+
+extern "C" {
+
+#endif
+
+#include "stddef.h"
+#include "stdbool.h"
+#include "stdlib.h"
+#include "string.h"
+#include "inline.h"
+#include "callconv.h"
+#include "stdatomic.h"
+
+/*
+ * Bounded multi-producer/multi-consumer queue of fixed-size elements.
+ *
+ * Every slot carries a sequence number telling which lap it is ready for:
+ * a producer claims position 'pos' with a CAS once the slot's sequence is
+ * 'pos', writes the element and releases the slot as 'pos + 1'; a consumer
+ * claims it at 'pos + 1' and hands it back for the next lap. Producers and
+ * consumers only share the slot they meet at, never a global lock.
+ *
+ * Queues created with MPMC_BLOCKING also support 'mpmc_enqueue' and
+ * 'mpmc_dequeue', which sleep through 'atomic_wait' while the queue is full
+ * or empty. The other side then checks for sleepers after each operation,
+ * which costs one full fence; non-blocking queues skip it.
+ */
+
+#if defined(NOCL_FEATURE_NO_STDATOMIC) || defined(NOCL_FEATURE_NO_STDLIB)
+
+#define NOCL_FEATURE_NO_MPMC
+
+#else
+
+#define MPMC_BLOCKING  1
+
+#define __NOCL_INTERNAL_MPMC_SPIN  64
+
+typedef struct nocl_mpmc {
+    atomic_size_t enqueue_pos;
+    char pad0[64];
+
+    atomic_size_t dequeue_pos;
+    char pad1[64];
+
+    size_t mask;
+    size_t elem_size;
+    size_t stride;
+    int flags;
+    unsigned char *slots;
+    char pad2[64];
+
+    /* Only touched by blocking queues. */
+    atomic_uint not_empty;
+    atomic_uint consumers_waiting;
+    char pad3[64];
+
+    atomic_uint not_full;
+    atomic_uint producers_waiting;
+} nocl_mpmc_t;
+
+#define __nocl_internal_mpmc_seq(queue,pos) \
+    ((atomic_size_t *) ((queue)->slots + ((pos) & (queue)->mask) * (queue)->stride))
+
+#define __nocl_internal_mpmc_data(queue,pos) \
+    ((queue)->slots + ((pos) & (queue)->mask) * (queue)->stride + sizeof(atomic_size_t))
+
+/* 'capacity' is rounded up to a power of two, and at least 2. */
+static inline nocl_mpmc_t *cdecl mpmc_create(size_t elem_size, size_t capacity, int flags) {
+    nocl_mpmc_t *queue;
+    size_t cap = 2, stride, i;
+
+    if (!elem_size || !capacity) return NULL;
+
+#if defined(NOCL_FEATURE_NO_ATOMIC_WAIT)
+
+    if (flags & MPMC_BLOCKING) return NULL;
+
+#endif
+
+    if (elem_size > (size_t) -1 / 2 - sizeof(atomic_size_t)) return NULL;
+    stride = (sizeof(atomic_size_t) + elem_size + sizeof(atomic_size_t) - 1) / sizeof(atomic_size_t) * sizeof(atomic_size_t);
+    while (cap < capacity) {
+        if (cap > ((size_t) -1 >> 1) / stride) return NULL;
+        cap <<= 1;
+    }
+
+    queue = malloc(sizeof(nocl_mpmc_t));
+    if (!queue) return NULL;
+    queue->slots = malloc(cap * stride);
+    if (!queue->slots) {
+        free(queue);
+        return NULL;
+    }
+
+    queue->mask = cap - 1;
+    queue->elem_size = elem_size;
+    queue->stride = stride;
+    queue->flags = flags;
+    for (i = 0; i < cap; i ++)
+        atomic_store_explicit(__nocl_internal_mpmc_seq(queue, i), i, memory_order_relaxed);
+    atomic_store_explicit(&queue->enqueue_pos, 0, memory_order_relaxed);
+    atomic_store_explicit(&queue->dequeue_pos, 0, memory_order_relaxed);
+    atomic_store_explicit(&queue->not_empty, 0, memory_order_relaxed);
+    atomic_store_explicit(&queue->consumers_waiting, 0, memory_order_relaxed);
+    atomic_store_explicit(&queue->not_full, 0, memory_order_relaxed);
+    atomic_store_explicit(&queue->producers_waiting, 0, memory_order_seq_cst);
+
+    return queue;
+}
+
+static inline void cdecl mpmc_destroy(nocl_mpmc_t *queue) {
+    if (!queue) return;
+    free(queue->slots);
+    free(queue);
+}
+
+static inline size_t cdecl mpmc_capacity(const nocl_mpmc_t *queue) {
+    return queue->mask + 1;
+}
+
+#if !defined(NOCL_FEATURE_NO_ATOMIC_WAIT)
+
+/* Bump 'event' if anyone sleeps on it; the fence pairs with the one in '_sleep'. */
+static inline void cdecl __nocl_internal_mpmc_signal(atomic_uint *event, atomic_uint *waiting) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(waiting, memory_order_relaxed)) return;
+    atomic_fetch_add_explicit(event, 1, memory_order_release);
+    atomic_notify_all(event);
+}
+
+#define __nocl_internal_mpmc_notify(queue,event,waiting) \
+    do { if ((queue)->flags & MPMC_BLOCKING) __nocl_internal_mpmc_signal(&(queue)->event, &(queue)->waiting); } while (0)
+
+#else
+
+#define __nocl_internal_mpmc_notify(queue,event,waiting)  ((void) 0)
+
+#endif
+
+static inline bool cdecl mpmc_try_enqueue(nocl_mpmc_t *queue, const void *elem) {
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    size_t seq;
+    ptrdiff_t diff;
+
+    for (;;) {
+        seq = atomic_load_explicit(__nocl_internal_mpmc_seq(queue, pos), memory_order_acquire);
+        diff = (ptrdiff_t) (seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        }
+        else if (diff < 0) return false;  /* A lap behind: the queue is full. */
+        else pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    }
+
+    memcpy(__nocl_internal_mpmc_data(queue, pos), elem, queue->elem_size);
+    atomic_store_explicit(__nocl_internal_mpmc_seq(queue, pos), pos + 1, memory_order_release);
+    __nocl_internal_mpmc_notify(queue, not_empty, consumers_waiting);
+    return true;
+}
+
+static inline bool cdecl mpmc_try_dequeue(nocl_mpmc_t *queue, void *elem) {
+    size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    size_t seq;
+    ptrdiff_t diff;
+
+    for (;;) {
+        seq = atomic_load_explicit(__nocl_internal_mpmc_seq(queue, pos), memory_order_acquire);
+        diff = (ptrdiff_t) (seq - (pos + 1));
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        }
+        else if (diff < 0) return false;  /* Not written yet: the queue is empty. */
+        else pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    }
+
+    memcpy(elem, __nocl_internal_mpmc_data(queue, pos), queue->elem_size);
+    atomic_store_explicit(__nocl_internal_mpmc_seq(queue, pos), pos + queue->mask + 1, memory_order_release);
+    __nocl_internal_mpmc_notify(queue, not_full, producers_waiting);
+    return true;
+}
+
+/* Enqueue up to 'count' elements from 'elems' in order; returns how many fit. */
+static inline size_t cdecl mpmc_try_enqueue_bulk(nocl_mpmc_t *queue, const void *elems, size_t count) {
+    const unsigned char *src = elems;
+    size_t i;
+    for (i = 0; i < count; i ++, src += queue->elem_size) {
+        if (!mpmc_try_enqueue(queue, src)) break;
+    }
+    return i;
+}
+
+/* Dequeue up to 'count' elements into 'elems'; returns how many there were. */
+static inline size_t cdecl mpmc_try_dequeue_bulk(nocl_mpmc_t *queue, void *elems, size_t count) {
+    unsigned char *dst = elems;
+    size_t i;
+    for (i = 0; i < count; i ++, dst += queue->elem_size) {
+        if (!mpmc_try_dequeue(queue, dst)) break;
+    }
+    return i;
+}
+
+#if !defined(NOCL_FEATURE_NO_ATOMIC_WAIT)
+
+/*
+ * Sleep until 'event' moves. Registering as a waiter before reading the
+ * event means that either the retry sees the other side's progress, or the
+ * other side sees the waiter and bumps the event after we read it.
+ */
+#define __nocl_internal_mpmc_sleep(queue,op,elem,event,waiting) \
+    do { \
+    unsigned int seen; \
+    int spin; \
+    for (spin = 0; spin < __NOCL_INTERNAL_MPMC_SPIN; spin ++) { \
+        if (op((queue), (elem))) return; \
+    } \
+    for (;;) { \
+        atomic_fetch_add_explicit(&(queue)->waiting, 1, memory_order_seq_cst); \
+        atomic_thread_fence(memory_order_seq_cst); \
+        seen = atomic_load_explicit(&(queue)->event, memory_order_acquire); \
+        if (op((queue), (elem))) { \
+            atomic_fetch_sub_explicit(&(queue)->waiting, 1, memory_order_relaxed); \
+            return; \
+        } \
+        atomic_wait_explicit(&(queue)->event, seen, memory_order_acquire); \
+        atomic_fetch_sub_explicit(&(queue)->waiting, 1, memory_order_relaxed); \
+        if (op((queue), (elem))) return; \
+    } \
+    } while (0)
+
+/* MPMC_BLOCKING queues only. */
+static inline void cdecl mpmc_enqueue(nocl_mpmc_t *queue, const void *elem) {
+    __nocl_internal_mpmc_sleep(queue, mpmc_try_enqueue, elem, not_full, producers_waiting);
+}
+
+/* MPMC_BLOCKING queues only. */
+static inline void cdecl mpmc_dequeue(nocl_mpmc_t *queue, void *elem) {
+    __nocl_internal_mpmc_sleep(queue, mpmc_try_dequeue, elem, not_empty, consumers_waiting);
+}
+
+#endif
+
+#endif
+
+#if defined(__cplusplus)
+
+}
+
+#endif
+
+#endif
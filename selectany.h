@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#if !defined(_NOCL_SELECTANY_H)
+#define _NOCL_SELECTANY_H
+
+#if defined(__cplusplus)
+
+extern "C" {
+
+#endif
+
+/*
+ * '_Selectany' marks a data definition in a header so that every translation
+ * unit including it shares one object instead of failing to link. There is
+ * no lower-case spelling: a 'selectany' macro would break the Windows SDK's
+ * own '__declspec(selectany)'. MSVC requires such definitions to have an
+ * initializer.
+ */
+
+#if /* MSVC 6.0 */ (defined(_MSC_VER) && _MSC_VER >= 1200) || \
+    /* MinGW/MinGW-w64 GCC 3.2.0 */ (defined(__GNUC__) && (defined(__MINGW32__) || defined(__CYGWIN__)))
+
+#define _Selectany  __declspec(selectany)
+
+#elif /* GCC 2.95.0 */ defined(__GNUC__) && (__GNUC__ >= 3 || (defined(__GNUC_MINOR__) && __GNUC__ == 2 && __GNUC_MINOR__ >= 95))
+
+#define _Selectany  __attribute__((__weak__))
+
+#else
+
+#define _Selectany
+
+#endif
+
+#if defined(__cplusplus)
+
+}
+
+#endif
+
+#endif
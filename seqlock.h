@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2015 Nick Strupat
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#if !defined(_NOCL_SEQLOCK_H)
+#define _NOCL_SEQLOCK_H
+
+#if defined(__cplusplus)
+
+extern "C" {
+
+#endif
+
+#include "stddef.h"
+#include "stdbool.h"
+#include "inttypes.h"
+#include "inline.h"
+#include "callconv.h"
+#include "threads.h"
+#include "stdatomic.h"
+
+/*
+ * Sequence locks for read-mostly data.
+ *
+ * Writers bump the sequence to odd, update the data and bump it to even
+ * again; a reader samples the sequence, reads, and retries if it was odd
+ * or has moved since. Readers never write shared memory, so any number
+ * of them scale without sharing a cache line in modified state. Writers
+ * are serialized by a spinlock inside the seqlock.
+ *
+ * The protected data must be read with 'seqlock_read' (or, for hand-written
+ * readers, only through the begin/retry pair and without acting on what was
+ * read before 'seqlock_read_retry' says it is consistent). The copy helpers
+ * move the data with relaxed atomic accesses, so a torn read is a retry
+ * rather than a data race.
+ */
+
+#if defined(NOCL_FEATURE_NO_STDATOMIC)
+
+#define NOCL_FEATURE_NO_SEQLOCK
+
+#else
+
+#define __NOCL_INTERNAL_SEQLOCK_SPIN  128
+
+typedef struct nocl_seqlock {
+    atomic_uint seq;
+    atomic_uint lock;
+} nocl_seqlock_t;
+
+#define NOCL_SEQLOCK_INIT  { 0, 0 }
+
+static inline void cdecl __nocl_internal_seqlock_relax(void) {
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+
+    _mm_pause();
+
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+
+    __asm__ __volatile__("pause");
+
+#elif defined(__GNUC__) && (defined(__aarch64__) || defined(__arm__))
+
+    __asm__ __volatile__("yield");
+
+#endif
+
+}
+
+static inline void cdecl seqlock_init(nocl_seqlock_t *sl) {
+    atomic_store_explicit(&sl->seq, 0, memory_order_relaxed);
+    atomic_store_explicit(&sl->lock, 0, memory_order_release);
+}
+
+/* Start a read; spins while a write is in progress. */
+static inline unsigned int cdecl seqlock_read_begin(nocl_seqlock_t *sl) {
+    unsigned int seq;
+    while ((seq = atomic_load_explicit(&sl->seq, memory_order_acquire)) & 1)
+        __nocl_internal_seqlock_relax();
+    return seq;
+}
+
+/* True if what was read since 'seqlock_read_begin' returned 'start' may be torn. */
+static inline bool cdecl seqlock_read_retry(nocl_seqlock_t *sl, unsigned int start) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&sl->seq, memory_order_relaxed) != start;
+}
+
+static inline void cdecl seqlock_write_lock(nocl_seqlock_t *sl) {
+    unsigned int expected;
+    int spin = 0;
+
+    for (;;) {
+        expected = 0;
+        if (!atomic_load_explicit(&sl->lock, memory_order_relaxed) &&
+            atomic_compare_exchange_weak_explicit(&sl->lock, &expected, 1, memory_order_acquire, memory_order_relaxed)) break;
+        if (++ spin < __NOCL_INTERNAL_SEQLOCK_SPIN) __nocl_internal_seqlock_relax();
+
+#if !defined(NOCL_FEATURE_NO_THREADS)
+
+        else thrd_yield();
+
+#endif
+
+    }
+
+    atomic_store_explicit(&sl->seq, atomic_load_explicit(&sl->seq, memory_order_relaxed) + 1, memory_order_relaxed);
+    /* Keep the data stores from moving above the odd sequence. */
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void cdecl seqlock_write_unlock(nocl_seqlock_t *sl) {
+    atomic_store_explicit(&sl->seq, atomic_load_explicit(&sl->seq, memory_order_relaxed) + 1, memory_order_release);
+    atomic_store_explicit(&sl->lock, 0, memory_order_release);
+}
+
+/* Copy with relaxed atomic accesses, a word at a time where both sides allow it. */
+static inline void cdecl __nocl_internal_seqlock_load(void *dst, const void *src, size_t size) {
+    unsigned char *d = dst;
+    const unsigned char *s = src;
+
+    if (!(((uintptr_t) d | (uintptr_t) s) % sizeof(size_t))) {
+        for (; size >= sizeof(size_t); size -= sizeof(size_t), d += sizeof(size_t), s += sizeof(size_t))
+            *(size_t *) d = atomic_load_explicit((atomic_size_t *) s, memory_order_relaxed);
+    }
+    for (; size; size --)
+        *d ++ = atomic_load_explicit((atomic_uchar *) s ++, memory_order_relaxed);
+}
+
+static inline void cdecl __nocl_internal_seqlock_store(void *dst, const void *src, size_t size) {
+    unsigned char *d = dst;
+    const unsigned char *s = src;
+
+    if (!(((uintptr_t) d | (uintptr_t) s) % sizeof(size_t))) {
+        for (; size >= sizeof(size_t); size -= sizeof(size_t), d += sizeof(size_t), s += sizeof(size_t))
+            atomic_store_explicit((atomic_size_t *) d, *(const size_t *) s, memory_order_relaxed);
+    }
+    for (; size; size --)
+        atomic_store_explicit((atomic_uchar *) d ++, *s ++, memory_order_relaxed);
+}
+
+/* Copy a consistent snapshot of the 'size' bytes at 'shared' out to 'dst'. */
+static inline void cdecl seqlock_read(nocl_seqlock_t *sl, void *dst, const void *shared, size_t size) {
+    unsigned int start;
+    do {
+        start = seqlock_read_begin(sl);
+        __nocl_internal_seqlock_load(dst, shared, size);
+    } while (seqlock_read_retry(sl, start));
+}
+
+/* Replace the 'size' bytes at 'shared' with 'src'. */
+static inline void cdecl seqlock_write(nocl_seqlock_t *sl, void *shared, const void *src, size_t size) {
+    seqlock_write_lock(sl);
+    __nocl_internal_seqlock_store(shared, src, size);
+    seqlock_write_unlock(sl);
+}
+
+#endif
+
+#if defined(__cplusplus)
+
+}
+
+#endif
+
+#endif
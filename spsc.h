@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2015 Nick Strupat
+ * Copyright (c) 2025 Mana Utsumi
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#if !defined(_NOCL_SPSC_H)
+#define _NOCL_SPSC_H
+
+#if defined(__cplusplus)
+
+extern "C" {
+
+#endif
+
+#include "stddef.h"
+#include "stdbool.h"
+#include "stdlib.h"
+#include "string.h"
+#include "inline.h"
+#include "callconv.h"
+#include "threads.h"
+#include "stdatomic.h"
+
+/*
+ * Single-producer/single-consumer ring buffer of fixed-size elements.
+ *
+ * Exactly one thread may push and exactly one thread may pop. Head and tail
+ * live on separate cache lines, and each side keeps a private copy of the
+ * other side's index, so it only touches the other line when the copy says
+ * the ring is full (or empty). Indices are published with release stores
+ * and read with acquire loads; nothing stronger is used on the fast path.
+ *
+ * Rings created with SPSC_BLOCKING also support 'spsc_push' and 'spsc_pop',
+ * which park on a threads.h condition variable while the ring is full or
+ * empty. Every push or pop on such a ring then pays one full fence to check
+ * for a parked peer, which is why blocking is opt-in.
+ */
+
+#if defined(NOCL_FEATURE_NO_STDATOMIC) || defined(NOCL_FEATURE_NO_STDLIB)
+
+#define NOCL_FEATURE_NO_SPSC
+
+#else
+
+#define SPSC_BLOCKING  1
+
+#define __NOCL_INTERNAL_SPSC_CONSUMER  1u
+#define __NOCL_INTERNAL_SPSC_PRODUCER  2u
+
+#define __NOCL_INTERNAL_SPSC_SPIN  64
+
+typedef struct nocl_spsc {
+    /* Written by the producer. */
+    atomic_size_t tail;
+    size_t head_cache;
+    char pad0[64];
+
+    /* Written by the consumer. */
+    atomic_size_t head;
+    size_t tail_cache;
+    char pad1[64];
+
+    size_t mask;
+    size_t elem_size;
+    int flags;
+    unsigned char *buffer;
+
+#if !defined(NOCL_FEATURE_NO_THREADS)
+
+    atomic_uint waiting;
+    mtx_t lock;
+    cnd_t cond;
+
+#endif
+
+} nocl_spsc_t;
+
+/* 'capacity' is rounded up to a power of two. */
+static inline nocl_spsc_t *cdecl spsc_create(size_t elem_size, size_t capacity, int flags) {
+    nocl_spsc_t *ring;
+    size_t cap = 1;
+
+    if (!elem_size || !capacity) return NULL;
+    while (cap < capacity) {
+        if (cap > ((size_t) -1 >> 1) / elem_size) return NULL;
+        cap <<= 1;
+    }
+
+#if defined(NOCL_FEATURE_NO_THREADS)
+
+    if (flags & SPSC_BLOCKING) return NULL;
+
+#endif
+
+    ring = malloc(sizeof(nocl_spsc_t));
+    if (!ring) return NULL;
+    ring->buffer = malloc(cap * elem_size);
+    if (!ring->buffer) {
+        free(ring);
+        return NULL;
+    }
+
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    ring->head_cache = 0;
+    ring->tail_cache = 0;
+    ring->mask = cap - 1;
+    ring->elem_size = elem_size;
+    ring->flags = flags;
+
+#if !defined(NOCL_FEATURE_NO_THREADS)
+
+    atomic_store_explicit(&ring->waiting, 0, memory_order_relaxed);
+    if (flags & SPSC_BLOCKING) {
+        if (mtx_init(&ring->lock, mtx_plain) != thrd_success) {
+            free(ring->buffer);
+            free(ring);
+            return NULL;
+        }
+        if (cnd_init(&ring->cond) != thrd_success) {
+            mtx_destroy(&ring->lock);
+            free(ring->buffer);
+            free(ring);
+            return NULL;
+        }
+    }
+
+#endif
+
+    return ring;
+}
+
+static inline void cdecl spsc_destroy(nocl_spsc_t *ring) {
+    if (!ring) return;
+
+#if !defined(NOCL_FEATURE_NO_THREADS)
+
+    if (ring->flags & SPSC_BLOCKING) {
+        cnd_destroy(&ring->cond);
+        mtx_destroy(&ring->lock);
+    }
+
+#endif
+
+    free(ring->buffer);
+    free(ring);
+}
+
+static inline size_t cdecl spsc_capacity(const nocl_spsc_t *ring) {
+    return ring->mask + 1;
+}
+
+/* Only exact when called by the producer or the consumer while the other side is idle. */
+static inline size_t cdecl spsc_size(nocl_spsc_t *ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return atomic_load_explicit(&ring->tail, memory_order_acquire) - head;
+}
+
+#if !defined(NOCL_FEATURE_NO_THREADS)
+
+/* Wake the peer if it is parked on 'side'; pairs with the fence-like RMW in '_park'. */
+static inline void cdecl __nocl_internal_spsc_wake(nocl_spsc_t *ring, unsigned int side) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!(atomic_load_explicit(&ring->waiting, memory_order_relaxed) & side)) return;
+    mtx_lock(&ring->lock);
+    cnd_broadcast(&ring->cond);
+    mtx_unlock(&ring->lock);
+}
+
+static inline bool cdecl __nocl_internal_spsc_blocked(nocl_spsc_t *ring, unsigned int side) {
+    if (side == __NOCL_INTERNAL_SPSC_CONSUMER)
+        return atomic_load_explicit(&ring->tail, memory_order_seq_cst) == atomic_load_explicit(&ring->head, memory_order_relaxed);
+    return atomic_load_explicit(&ring->tail, memory_order_relaxed) - atomic_load_explicit(&ring->head, memory_order_seq_cst) > ring->mask;
+}
+
+static inline void cdecl __nocl_internal_spsc_park(nocl_spsc_t *ring, unsigned int side) {
+    mtx_lock(&ring->lock);
+    atomic_fetch_or_explicit(&ring->waiting, side, memory_order_seq_cst);
+    while (__nocl_internal_spsc_blocked(ring, side))
+        cnd_wait(&ring->cond, &ring->lock);
+    atomic_fetch_and_explicit(&ring->waiting, ~side, memory_order_relaxed);
+    mtx_unlock(&ring->lock);
+}
+
+#define __nocl_internal_spsc_notify(ring,side) \
+    do { if ((ring)->flags & SPSC_BLOCKING) __nocl_internal_spsc_wake((ring), (side)); } while (0)
+
+#else
+
+#define __nocl_internal_spsc_notify(ring,side)  ((void) 0)
+
+#endif
+
+/* Push up to 'count' elements from 'elems'; returns how many fit. Producer only. */
+static inline size_t cdecl spsc_push_batch(nocl_spsc_t *ring, const void *elems, size_t count) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t cap = ring->mask + 1;
+    size_t avail = cap - (tail - ring->head_cache);
+    size_t index, first;
+
+    if (avail < count) {
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+        avail = cap - (tail - ring->head_cache);
+        if (count > avail) count = avail;
+        if (!count) return 0;
+    }
+
+    index = tail & ring->mask;
+    first = cap - index < count ? cap - index : count;
+    memcpy(ring->buffer + index * ring->elem_size, elems, first * ring->elem_size);
+    memcpy(ring->buffer, (const unsigned char *) elems + first * ring->elem_size, (count - first) * ring->elem_size);
+
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+    __nocl_internal_spsc_notify(ring, __NOCL_INTERNAL_SPSC_CONSUMER);
+    return count;
+}
+
+/* Pop up to 'count' elements into 'elems'; returns how many there were. Consumer only. */
+static inline size_t cdecl spsc_pop_batch(nocl_spsc_t *ring, void *elems, size_t count) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t cap = ring->mask + 1;
+    size_t avail = ring->tail_cache - head;
+    size_t index, first;
+
+    if (avail < count) {
+        ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        avail = ring->tail_cache - head;
+        if (count > avail) count = avail;
+        if (!count) return 0;
+    }
+
+    index = head & ring->mask;
+    first = cap - index < count ? cap - index : count;
+    memcpy(elems, ring->buffer + index * ring->elem_size, first * ring->elem_size);
+    memcpy((unsigned char *) elems + first * ring->elem_size, ring->buffer, (count - first) * ring->elem_size);
+
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+    __nocl_internal_spsc_notify(ring, __NOCL_INTERNAL_SPSC_PRODUCER);
+    return count;
+}
+
+static inline bool cdecl spsc_try_push(nocl_spsc_t *ring, const void *elem) {
+    return spsc_push_batch(ring, elem, 1) == 1;
+}
+
+static inline bool cdecl spsc_try_pop(nocl_spsc_t *ring, void *elem) {
+    return spsc_pop_batch(ring, elem, 1) == 1;
+}
+
+#if !defined(NOCL_FEATURE_NO_THREADS)
+
+/* Push all 'count' elements, parking while the ring is full. SPSC_BLOCKING rings only. */
+static inline void cdecl spsc_push_batch_wait(nocl_spsc_t *ring, const void *elems, size_t count) {
+    const unsigned char *src = elems;
+    size_t n;
+    int spin = 0;
+
+    while (count) {
+        n = spsc_push_batch(ring, src, count);
+        src += n * ring->elem_size;
+        count -= n;
+        if (n) spin = 0;
+        else if (++ spin > __NOCL_INTERNAL_SPSC_SPIN) {
+            __nocl_internal_spsc_park(ring, __NOCL_INTERNAL_SPSC_PRODUCER);
+            spin = 0;
+        }
+    }
+}
+
+/* Pop at least one and up to 'count' elements, parking while the ring is empty. SPSC_BLOCKING rings only. */
+static inline size_t cdecl spsc_pop_batch_wait(nocl_spsc_t *ring, void *elems, size_t count) {
+    size_t n;
+    int spin = 0;
+
+    if (!count) return 0;
+    while (!((n = spsc_pop_batch(ring, elems, count)))) {
+        if (++ spin > __NOCL_INTERNAL_SPSC_SPIN) {
+            __nocl_internal_spsc_park(ring, __NOCL_INTERNAL_SPSC_CONSUMER);
+            spin = 0;
+        }
+    }
+    return n;
+}
+
+static inline void cdecl spsc_push(nocl_spsc_t *ring, const void *elem) {
+    spsc_push_batch_wait(ring, elem, 1);
+}
+
+static inline void cdecl spsc_pop(nocl_spsc_t *ring, void *elem) {
+    spsc_pop_batch_wait(ring, elem, 1);
+}
+
+#endif
+
+#endif
+
+#if defined(__cplusplus)
+
+}
+
+#endif
+
+#endif
@@ -45,6 +45,8 @@ extern "C" {
 
 #define atomic  _Atomic
 
+#define __NOCL_INTERNAL_STDATOMIC_SYSTEM
+
 #elif /* Win32 */ defined(_WIN32) && \
     /* MSC 1.0 */ defined(_MSC_VER) && \
     (defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM) || defined(_M_ARM64) || defined(_M_ARM64EC) || defined(_M_HYBRID_X86_ARM64))
@@ -1324,13 +1326,16 @@ __inline void __cdecl atomic_flag_clear_explicit(volatile atomic_flag* obj, cons
 #define _Atomic  volatile
 #define atomic   _Atomic
 
-#define ATOMIC_BOOL_LOCK_FREE     1
-#define ATOMIC_CHAR_LOCK_FREE     1
-#define ATOMIC_SHORT_LOCK_FREE    1
-#define ATOMIC_INT_LOCK_FREE      1
-#define ATOMIC_LONG_LOCK_FREE     1
-#define ATOMIC_LLONG_LOCK_FREE    1
-#define ATOMIC_POINTER_LOCK_FREE  2
+#define ATOMIC_BOOL_LOCK_FREE      __GCC_ATOMIC_BOOL_LOCK_FREE
+#define ATOMIC_CHAR_LOCK_FREE      __GCC_ATOMIC_CHAR_LOCK_FREE
+#define ATOMIC_CHAR16_T_LOCK_FREE  __GCC_ATOMIC_CHAR16_T_LOCK_FREE
+#define ATOMIC_CHAR32_T_LOCK_FREE  __GCC_ATOMIC_CHAR32_T_LOCK_FREE
+#define ATOMIC_WCHAR_T_LOCK_FREE   __GCC_ATOMIC_WCHAR_T_LOCK_FREE
+#define ATOMIC_SHORT_LOCK_FREE     __GCC_ATOMIC_SHORT_LOCK_FREE
+#define ATOMIC_INT_LOCK_FREE       __GCC_ATOMIC_INT_LOCK_FREE
+#define ATOMIC_LONG_LOCK_FREE      __GCC_ATOMIC_LONG_LOCK_FREE
+#define ATOMIC_LLONG_LOCK_FREE     __GCC_ATOMIC_LLONG_LOCK_FREE
+#define ATOMIC_POINTER_LOCK_FREE   __GCC_ATOMIC_POINTER_LOCK_FREE
 
 #define ATOMIC_FLAG_INIT  0
 
@@ -1396,10 +1401,11 @@ typedef atomic_int atomic_flag;
 #define atomic_thread_fence  __atomic_thread_fence
 #define atomic_signal_fence  __atomic_signal_fence
 
-#define atomic_is_lock_free(obj)  __atomic_is_lock_free(sizeof(*(obj)), (obj))
+#define atomic_is_lock_free(obj) \
+    (sizeof(*(obj)) == 16 ? __nocl_internal_stdatomic_lock_free16() : __atomic_is_lock_free(sizeof(*(obj)), (obj)))
 
 #define atomic_store(obj,desired)     __atomic_store_n((obj), (desired), memory_order_seq_cst)
-#define atomic_load(obj,desired)      __atomic_load_n((obj), (desired), memory_order_seq_cst)
+#define atomic_load(obj)              __atomic_load_n((obj), memory_order_seq_cst)
 #define atomic_exchange(obj,desired)  __atomic_exchange_n((obj), (desired), memory_order_seq_cst)
 
 #define atomic_store_explicit     __atomic_store_n
@@ -1440,6 +1446,22 @@ typedef atomic_int atomic_flag;
 #define _Atomic  volatile
 #define atomic   _Atomic
 
+/* Clang takes this branch before C11 and reports the real values. */
+#if defined(__GCC_ATOMIC_INT_LOCK_FREE)
+
+#define ATOMIC_BOOL_LOCK_FREE      __GCC_ATOMIC_BOOL_LOCK_FREE
+#define ATOMIC_CHAR_LOCK_FREE      __GCC_ATOMIC_CHAR_LOCK_FREE
+#define ATOMIC_CHAR16_T_LOCK_FREE  __GCC_ATOMIC_CHAR16_T_LOCK_FREE
+#define ATOMIC_CHAR32_T_LOCK_FREE  __GCC_ATOMIC_CHAR32_T_LOCK_FREE
+#define ATOMIC_WCHAR_T_LOCK_FREE   __GCC_ATOMIC_WCHAR_T_LOCK_FREE
+#define ATOMIC_SHORT_LOCK_FREE     __GCC_ATOMIC_SHORT_LOCK_FREE
+#define ATOMIC_INT_LOCK_FREE       __GCC_ATOMIC_INT_LOCK_FREE
+#define ATOMIC_LONG_LOCK_FREE      __GCC_ATOMIC_LONG_LOCK_FREE
+#define ATOMIC_LLONG_LOCK_FREE     __GCC_ATOMIC_LLONG_LOCK_FREE
+#define ATOMIC_POINTER_LOCK_FREE   __GCC_ATOMIC_POINTER_LOCK_FREE
+
+#else
+
 #define ATOMIC_BOOL_LOCK_FREE     1
 #define ATOMIC_CHAR_LOCK_FREE     1
 #define ATOMIC_SHORT_LOCK_FREE    1
@@ -1448,6 +1470,8 @@ typedef atomic_int atomic_flag;
 #define ATOMIC_LLONG_LOCK_FREE    1
 #define ATOMIC_POINTER_LOCK_FREE  2
 
+#endif
+
 #define ATOMIC_FLAG_INIT  0
 
 #if /* C23 */ !defined(__STDC_VERSION__) || __STDC_VERSION__ < 202311L
@@ -1540,11 +1564,11 @@ typedef atomic_int atomic_flag;
 /* Always using the strongest memory order. */
 
 /* Atomic loads can be implemented in terms of a compare-and-swap. */
-#define atomic_load(obj)  __sync_val_compare_and_swap((obj), 0, 0))
+#define atomic_load(obj)  __sync_val_compare_and_swap((obj), 0, 0)
 #define atomic_load_explicit(obj,mo) \
     ((mo) == memory_order_relaxed ? *(obj) : __sync_val_compare_and_swap((obj), 0, 0))
 
-#define atomic_exchange(obj,desired)  __sync_lock_test_and_set(obj, desired)
+#define atomic_exchange(obj,desired)  atomic_exchange_explicit((obj), (desired), memory_order_seq_cst)
 #define atomic_exchange_explicit(obj,desired,mo) \
     ({ \
     if ((mo) != memory_order_acquire) __sync_synchronize(); \
@@ -1555,24 +1579,19 @@ typedef atomic_int atomic_flag;
 #define atomic_store_explicit  (void) atomic_exchange_explicit
 
 #define atomic_fetch_add(obj,arg)  __sync_fetch_and_add((obj), (arg))
-#define atomic_fetch_add_explicit(obj,arg,mo) \
-    ((mo) == memory_order_relaxed ? ((obj) + (arg)) : __sync_fetch_and_add((obj), (arg)))
+#define atomic_fetch_add_explicit(obj,arg,mo)  ((void) (mo), __sync_fetch_and_add((obj), (arg)))
 
 #define atomic_fetch_sub(obj,arg)  __sync_fetch_and_sub((obj), (arg))
-#define atomic_fetch_sub_explicit(obj,arg,mo) \
-    ((mo) == memory_order_relaxed ? ((obj) - (arg)) : __sync_fetch_and_sub((obj), (arg)))
+#define atomic_fetch_sub_explicit(obj,arg,mo)  ((void) (mo), __sync_fetch_and_sub((obj), (arg)))
 
 #define atomic_fetch_and(obj,mask)  __sync_fetch_and_and((obj), (mask))
-#define atomic_fetch_and_explicit(obj,mask,mo) \
-    ((mo) == memory_order_relaxed ? ((obj) & (mask)) : __sync_fetch_and_and((obj), (mask)))
+#define atomic_fetch_and_explicit(obj,mask,mo)  ((void) (mo), __sync_fetch_and_and((obj), (mask)))
 
 #define atomic_fetch_or(obj,mask)  __sync_fetch_and_or((obj), (mask))
-#define atomic_fetch_or_explicit(obj,mask,mo) \
-    ((mo) == memory_order_relaxed ? ((obj) | (mask)) : __sync_fetch_and_or((obj), (mask)))
+#define atomic_fetch_or_explicit(obj,mask,mo)  ((void) (mo), __sync_fetch_and_or((obj), (mask)))
 
 #define atomic_fetch_xor(obj,mask)  __sync_fetch_and_xor((obj), (mask))
-#define atomic_fetch_xor_explicit(obj,mask,mo) \
-    ((mo) == memory_order_relaxed ? ((obj) ^ (mask)) : __sync_fetch_and_xor((obj), (mask)))
+#define atomic_fetch_xor_explicit(obj,mask,mo)  ((void) (mo), __sync_fetch_and_xor((obj), (mask)))
 
 #define atomic_compare_exchange_strong(obj,expected,desired) \
     ({ \
@@ -1587,31 +1606,14 @@ typedef atomic_int atomic_flag;
     })
 
 #define atomic_compare_exchange_strong_explicit(obj,expected,desired,smo,fmo) \
-    ({ \
-    bool retval; \
-    if ((smo) == memory_order_relaxed && (fmo) == memory_order_relaxed) { \
-        if (*(obj) == *(expected)) retval = true; \
-        else { \
-            *(expected) = *(obj); \
-            retval = false; \
-        } \
-    } \
-    else { \
-        const __typeof__(*(obj)) res = __sync_val_compare_and_swap((obj), *(expected), (desired)); \
-        if (res == *(expected)) retval = true; \
-        else { \
-            *(expected) = res; \
-            retval = false; \
-        } \
-    } \
-    retval; \
-    })
+    ((void) (smo), (void) (fmo), atomic_compare_exchange_strong((obj), (expected), (desired)))
 
 #define atomic_compare_exchange_weak           atomic_compare_exchange_strong
 #define atomic_compare_exchange_weak_explicit  atomic_compare_exchange_strong_explicit
 
 #define atomic_is_lock_free(obj) \
-    ((bool) !!((sizeof(*(obj)) == 1) || (sizeof(*(obj)) == 2) || (sizeof(*(obj)) == 4) || (sizeof(*(obj)) == 8)))
+    ((bool) !!((sizeof(*(obj)) == 1) || (sizeof(*(obj)) == 2) || (sizeof(*(obj)) == 4) || (sizeof(*(obj)) == 8) || \
+    (sizeof(*(obj)) == 16 && __nocl_internal_stdatomic_lock_free16())))
 
 #endif
 
@@ -1621,6 +1623,904 @@ typedef atomic_int atomic_flag;
 
 #endif
 
+/*
+ * Typed accessors.
+ *
+ * Where '_Atomic' is only 'volatile', assignments, '++' and friends on an
+ * atomic object are plain accesses. 'atomic_int_load(&x)',
+ * 'atomic_int_fetch_add(&x, 1)' and so on are sequentially consistent
+ * everywhere, so code written against them stays correct on every branch.
+ */
+
+#if !defined(NOCL_FEATURE_NO_STDATOMIC) && \
+    (/* C11 */ (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L) || defined(__GNUC__))
+
+#include "inttypes.h"
+#include "stddef.h"
+#include "stdbool.h"
+#include "inline.h"
+#include "callconv.h"
+
+#define __nocl_internal_stdatomic_accessors(name,type) \
+    static inline type cdecl name##_load(volatile name *obj) { return atomic_load_explicit(obj, memory_order_seq_cst); } \
+    static inline void cdecl name##_store(volatile name *obj, type desired) { atomic_store_explicit(obj, desired, memory_order_seq_cst); } \
+    static inline type cdecl name##_exchange(volatile name *obj, type desired) { return atomic_exchange_explicit(obj, desired, memory_order_seq_cst); } \
+    static inline bool cdecl name##_compare_exchange_strong(volatile name *obj, type *expected, type desired) { \
+        return atomic_compare_exchange_strong_explicit(obj, expected, desired, memory_order_seq_cst, memory_order_seq_cst); \
+    } \
+    static inline bool cdecl name##_compare_exchange_weak(volatile name *obj, type *expected, type desired) { \
+        return atomic_compare_exchange_weak_explicit(obj, expected, desired, memory_order_seq_cst, memory_order_seq_cst); \
+    }
+
+#define __nocl_internal_stdatomic_arithmetic_accessors(name,type) \
+    __nocl_internal_stdatomic_accessors(name, type) \
+    static inline type cdecl name##_fetch_add(volatile name *obj, type arg) { return atomic_fetch_add_explicit(obj, arg, memory_order_seq_cst); } \
+    static inline type cdecl name##_fetch_sub(volatile name *obj, type arg) { return atomic_fetch_sub_explicit(obj, arg, memory_order_seq_cst); } \
+    static inline type cdecl name##_fetch_and(volatile name *obj, type arg) { return atomic_fetch_and_explicit(obj, arg, memory_order_seq_cst); } \
+    static inline type cdecl name##_fetch_or(volatile name *obj, type arg) { return atomic_fetch_or_explicit(obj, arg, memory_order_seq_cst); } \
+    static inline type cdecl name##_fetch_xor(volatile name *obj, type arg) { return atomic_fetch_xor_explicit(obj, arg, memory_order_seq_cst); }
+
+__nocl_internal_stdatomic_accessors(atomic_bool, bool)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_char, char)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_schar, signed char)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_uchar, unsigned char)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_short, short)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_ushort, unsigned short)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_int, int)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_uint, unsigned int)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_long, long)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_ulong, unsigned long)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_llong, long long)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_ullong, unsigned long long)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_intptr_t, intptr_t)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_uintptr_t, uintptr_t)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_size_t, size_t)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_ptrdiff_t, ptrdiff_t)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_intmax_t, intmax_t)
+__nocl_internal_stdatomic_arithmetic_accessors(atomic_uintmax_t, uintmax_t)
+
+#endif
+
+/*
+ * Maximum, minimum and floating-point read-modify-writes.
+ *
+ * 'atomic_int_fetch_max(&x, v)' and friends store the larger (or smaller)
+ * of the current value and 'v' and return the previous value, as the other
+ * fetch operations do. Where the current value already wins, they return
+ * after a single load without writing. On AArch64 with LSE, 32- and 64-bit
+ * integers use 'ldsmax'/'ldumax'/'ldsmin'/'ldumin' instead.
+ *
+ * 'atomic_float' and 'atomic_double' get the typed accessors plus
+ * 'fetch_add', 'fetch_sub', 'fetch_max' and 'fetch_min', all as loops over
+ * a compare-exchange of the bits. A NaN argument never replaces the value
+ * in 'fetch_max'/'fetch_min', and a stored NaN is never replaced by them.
+ * With C11 '_Generic', 'atomic_fetch_max' and 'atomic_fetch_min' pick the
+ * right function for any of the basic arithmetic types.
+ */
+
+#if !defined(NOCL_FEATURE_NO_STDATOMIC) && \
+    (/* C11 */ (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L) || defined(__GNUC__))
+
+#include "inttypes.h"
+#include "stdbool.h"
+#include "string.h"
+#include "inline.h"
+#include "callconv.h"
+#include "generic.h"
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_ATOMICS)
+
+#define __nocl_internal_stdatomic_lse(name,insn,type,reg) \
+    static __inline__ type __nocl_internal_stdatomic_##name(volatile void *obj, type arg) { \
+        type old; \
+        __asm__ __volatile__(insn " %" reg "2, %" reg "0, %1" : "=&r" (old), "+Q" (*(volatile type *) obj) : "r" (arg) : "memory"); \
+        return old; \
+    }
+
+__nocl_internal_stdatomic_lse(smax32, "ldsmaxal", int32_t, "w")
+__nocl_internal_stdatomic_lse(umax32, "ldumaxal", uint32_t, "w")
+__nocl_internal_stdatomic_lse(smin32, "ldsminal", int32_t, "w")
+__nocl_internal_stdatomic_lse(umin32, "lduminal", uint32_t, "w")
+__nocl_internal_stdatomic_lse(smax64, "ldsmaxal", int64_t, "x")
+__nocl_internal_stdatomic_lse(umax64, "ldumaxal", uint64_t, "x")
+__nocl_internal_stdatomic_lse(smin64, "ldsminal", int64_t, "x")
+__nocl_internal_stdatomic_lse(umin64, "lduminal", uint64_t, "x")
+
+/* The size and signedness tests fold away, leaving one instruction. */
+#define __nocl_internal_stdatomic_lse_dispatch(type,op,obj,arg) \
+    if (sizeof(type) == 4) \
+        return (type) ((type) -1 < 0 ? __nocl_internal_stdatomic_s##op##32((obj), (int32_t) (arg)) : \
+            (type) __nocl_internal_stdatomic_u##op##32((obj), (uint32_t) (arg))); \
+    if (sizeof(type) == 8) \
+        return (type) ((type) -1 < 0 ? __nocl_internal_stdatomic_s##op##64((obj), (int64_t) (arg)) : \
+            (type) __nocl_internal_stdatomic_u##op##64((obj), (uint64_t) (arg)));
+
+#else
+
+#define __nocl_internal_stdatomic_lse_dispatch(type,op,obj,arg)
+
+#endif
+
+#define __nocl_internal_stdatomic_minmax(name,type,op,cmp) \
+    static inline type cdecl name##_fetch_##op(volatile name *obj, type arg) { \
+        type current; \
+        __nocl_internal_stdatomic_lse_dispatch(type, op, obj, arg) \
+        current = atomic_load_explicit(obj, memory_order_seq_cst); \
+        while (arg cmp current && \
+            !atomic_compare_exchange_weak_explicit(obj, &current, arg, memory_order_seq_cst, memory_order_seq_cst)); \
+        return current; \
+    }
+
+#define __nocl_internal_stdatomic_minmax_accessors(name,type) \
+    __nocl_internal_stdatomic_minmax(name, type, max, >) \
+    __nocl_internal_stdatomic_minmax(name, type, min, <)
+
+__nocl_internal_stdatomic_minmax_accessors(atomic_char, char)
+__nocl_internal_stdatomic_minmax_accessors(atomic_schar, signed char)
+__nocl_internal_stdatomic_minmax_accessors(atomic_uchar, unsigned char)
+__nocl_internal_stdatomic_minmax_accessors(atomic_short, short)
+__nocl_internal_stdatomic_minmax_accessors(atomic_ushort, unsigned short)
+__nocl_internal_stdatomic_minmax_accessors(atomic_int, int)
+__nocl_internal_stdatomic_minmax_accessors(atomic_uint, unsigned int)
+__nocl_internal_stdatomic_minmax_accessors(atomic_long, long)
+__nocl_internal_stdatomic_minmax_accessors(atomic_ulong, unsigned long)
+__nocl_internal_stdatomic_minmax_accessors(atomic_llong, long long)
+__nocl_internal_stdatomic_minmax_accessors(atomic_ullong, unsigned long long)
+__nocl_internal_stdatomic_minmax_accessors(atomic_intptr_t, intptr_t)
+__nocl_internal_stdatomic_minmax_accessors(atomic_uintptr_t, uintptr_t)
+__nocl_internal_stdatomic_minmax_accessors(atomic_size_t, size_t)
+__nocl_internal_stdatomic_minmax_accessors(atomic_ptrdiff_t, ptrdiff_t)
+__nocl_internal_stdatomic_minmax_accessors(atomic_intmax_t, intmax_t)
+__nocl_internal_stdatomic_minmax_accessors(atomic_uintmax_t, uintmax_t)
+
+typedef _Atomic float atomic_float;
+typedef _Atomic double atomic_double;
+
+/* Floating-point atomics travel as their bits, which every branch can handle. */
+#define __nocl_internal_stdatomic_float_bits(obj,bits) \
+    ((volatile atomic_uint_least##bits##_t *) (obj))
+
+#define __nocl_internal_stdatomic_float_rmw(name,type,bits,op,update) \
+    static inline type cdecl name##_fetch_##op(volatile name *obj, type arg) { \
+        uint##bits##_t expected = atomic_load_explicit(__nocl_internal_stdatomic_float_bits(obj, bits), memory_order_seq_cst), desired; \
+        type current, next; \
+        for (;;) { \
+            memcpy(&current, &expected, sizeof(type)); \
+            update; \
+            memcpy(&desired, &next, sizeof(type)); \
+            if (atomic_compare_exchange_weak_explicit(__nocl_internal_stdatomic_float_bits(obj, bits), &expected, desired, \
+                memory_order_seq_cst, memory_order_seq_cst)) return current; \
+        } \
+    }
+
+#define __nocl_internal_stdatomic_float_accessors(name,type,bits) \
+    static inline type cdecl name##_load(volatile name *obj) { \
+        uint##bits##_t value = atomic_load_explicit(__nocl_internal_stdatomic_float_bits(obj, bits), memory_order_seq_cst); \
+        type res; \
+        memcpy(&res, &value, sizeof(type)); \
+        return res; \
+    } \
+    static inline void cdecl name##_store(volatile name *obj, type desired) { \
+        uint##bits##_t value; \
+        memcpy(&value, &desired, sizeof(type)); \
+        atomic_store_explicit(__nocl_internal_stdatomic_float_bits(obj, bits), value, memory_order_seq_cst); \
+    } \
+    static inline type cdecl name##_exchange(volatile name *obj, type desired) { \
+        uint##bits##_t value; \
+        type res; \
+        memcpy(&value, &desired, sizeof(type)); \
+        value = atomic_exchange_explicit(__nocl_internal_stdatomic_float_bits(obj, bits), value, memory_order_seq_cst); \
+        memcpy(&res, &value, sizeof(type)); \
+        return res; \
+    } \
+    /* Compares bits, so -0.0 does not match 0.0 and a NaN matches itself. */ \
+    static inline bool cdecl name##_compare_exchange_strong(volatile name *obj, type *expected, type desired) { \
+        uint##bits##_t old, value; \
+        bool res; \
+        memcpy(&old, expected, sizeof(type)); \
+        memcpy(&value, &desired, sizeof(type)); \
+        res = atomic_compare_exchange_strong_explicit(__nocl_internal_stdatomic_float_bits(obj, bits), &old, value, \
+            memory_order_seq_cst, memory_order_seq_cst); \
+        memcpy(expected, &old, sizeof(type)); \
+        return res; \
+    } \
+    static inline bool cdecl name##_compare_exchange_weak(volatile name *obj, type *expected, type desired) { \
+        return name##_compare_exchange_strong(obj, expected, desired); \
+    } \
+    __nocl_internal_stdatomic_float_rmw(name, type, bits, add, next = current + arg) \
+    __nocl_internal_stdatomic_float_rmw(name, type, bits, sub, next = current - arg) \
+    static inline type cdecl name##_fetch_max(volatile name *obj, type arg) { \
+        type current = name##_load(obj); \
+        while (arg > current && !name##_compare_exchange_weak(obj, &current, arg)); \
+        return current; \
+    } \
+    static inline type cdecl name##_fetch_min(volatile name *obj, type arg) { \
+        type current = name##_load(obj); \
+        while (arg < current && !name##_compare_exchange_weak(obj, &current, arg)); \
+        return current; \
+    }
+
+__nocl_internal_stdatomic_float_accessors(atomic_float, float, 32)
+__nocl_internal_stdatomic_float_accessors(atomic_double, double, 64)
+
+#if !defined(NOCL_FEATURE_NO_GENERIC)
+
+#define __nocl_internal_stdatomic_generic_minmax(obj,op) \
+    _Generic(*(obj), \
+        char: atomic_char_fetch_##op, \
+        signed char: atomic_schar_fetch_##op, \
+        unsigned char: atomic_uchar_fetch_##op, \
+        short: atomic_short_fetch_##op, \
+        unsigned short: atomic_ushort_fetch_##op, \
+        int: atomic_int_fetch_##op, \
+        unsigned int: atomic_uint_fetch_##op, \
+        long: atomic_long_fetch_##op, \
+        unsigned long: atomic_ulong_fetch_##op, \
+        long long: atomic_llong_fetch_##op, \
+        unsigned long long: atomic_ullong_fetch_##op, \
+        float: atomic_float_fetch_##op, \
+        double: atomic_double_fetch_##op)
+
+#define atomic_fetch_max(obj,arg)  __nocl_internal_stdatomic_generic_minmax(obj, max)((obj), (arg))
+#define atomic_fetch_min(obj,arg)  __nocl_internal_stdatomic_generic_minmax(obj, min)((obj), (arg))
+
+#endif
+
+#endif
+
+/*
+ * 16-byte atomics, e.g. for pointer and tag pairs.
+ *
+ * Lock-free through cmpxchg16b on x86-64 where the CPU has it (checked once
+ * at run time) and through ldaxp/stlxp on AArch64. Elsewhere, operations
+ * serialize on a table of striped spinlocks, so an object must only be
+ * accessed through these functions. Every operation is sequentially
+ * consistent, and loads write to the object, so it must not be read-only.
+ */
+
+#if !defined(NOCL_FEATURE_NO_STDATOMIC) && \
+    /* GCC 4.1.0 */ (defined(__GNUC__) && (__GNUC__ >= 5 || (defined(__GNUC_MINOR__) && __GNUC__ == 4 && __GNUC_MINOR__ >= 1)))
+
+#include "inttypes.h"
+#include "stdbool.h"
+#include "selectany.h"
+
+#if defined(__x86_64__)
+
+#define ATOMIC_UINT128_LOCK_FREE  1
+
+#elif defined(__aarch64__)
+
+#define ATOMIC_UINT128_LOCK_FREE  2
+
+#else
+
+#define ATOMIC_UINT128_LOCK_FREE  0
+
+#endif
+
+#define ATOMIC_UINT128_INIT(lo,hi)  { { (lo), (hi) } }
+
+typedef struct nocl_uint128_t {
+    uint64_t lo;
+    uint64_t hi;
+} nocl_uint128_t;
+
+typedef struct atomic_uint128 {
+    nocl_uint128_t value __attribute__((aligned(16)));
+} atomic_uint128;
+
+#define __NOCL_INTERNAL_STDATOMIC_LOCKS  64
+
+struct __nocl_internal_stdatomic_lock {
+    int lock;
+    char pad[64 - sizeof(int)];
+} __attribute__((aligned(64)));
+
+_Selectany struct __nocl_internal_stdatomic_lock __nocl_internal_stdatomic_locks[__NOCL_INTERNAL_STDATOMIC_LOCKS] = { { 0 } };
+
+#if defined(__x86_64__)
+
+/* 0 until checked, then 1 with cmpxchg16b and 2 without. */
+_Selectany int __nocl_internal_stdatomic_cx16 = 0;
+
+static __inline__ bool __nocl_internal_stdatomic_lock_free16(void) {
+    int cx16 = *(volatile int *) &__nocl_internal_stdatomic_cx16;
+    if (!cx16) {
+        unsigned int eax = 1, ebx, ecx = 0, edx;
+        __asm__ __volatile__("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+        cx16 = (ecx & (1u << 13)) ? 1 : 2;
+        *(volatile int *) &__nocl_internal_stdatomic_cx16 = cx16;
+    }
+    return cx16 == 1;
+}
+
+#elif defined(__aarch64__)
+
+static __inline__ bool __nocl_internal_stdatomic_lock_free16(void) {
+    return true;
+}
+
+#else
+
+static __inline__ bool __nocl_internal_stdatomic_lock_free16(void) {
+    return false;
+}
+
+#endif
+
+static __inline__ bool atomic_compare_exchange_strong_uint128(volatile atomic_uint128 *obj, nocl_uint128_t *expected, nocl_uint128_t desired) {
+    bool res;
+
+#if defined(__x86_64__)
+
+    if (__nocl_internal_stdatomic_lock_free16()) {
+        __asm__ __volatile__("lock; cmpxchg16b %1\n\tsete %0"
+            : "=q" (res), "+m" (obj->value), "+a" (expected->lo), "+d" (expected->hi)
+            : "b" (desired.lo), "c" (desired.hi)
+            : "memory", "cc");
+        return res;
+    }
+
+#elif defined(__aarch64__)
+
+    uint64_t lo, hi;
+    uint32_t fail;
+
+    /* On a mismatch the old value is stored back, which makes the pair read single-copy atomic. */
+    __asm__ __volatile__(
+        "1:\tldaxp %0, %1, %3\n"
+        "\tcmp %0, %4\n"
+        "\tccmp %1, %5, #0, eq\n"
+        "\tb.ne 2f\n"
+        "\tstlxp %w2, %6, %7, %3\n"
+        "\tcbnz %w2, 1b\n"
+        "\tb 3f\n"
+        "2:\tstlxp %w2, %0, %1, %3\n"
+        "\tcbnz %w2, 1b\n"
+        "3:"
+        : "=&r" (lo), "=&r" (hi), "=&r" (fail), "+Q" (obj->value)
+        : "r" (expected->lo), "r" (expected->hi), "r" (desired.lo), "r" (desired.hi)
+        : "memory", "cc");
+
+    res = lo == expected->lo && hi == expected->hi;
+    expected->lo = lo;
+    expected->hi = hi;
+    return res;
+
+#endif
+
+#if !defined(__aarch64__)
+
+    volatile int *lock = &__nocl_internal_stdatomic_locks[((uintptr_t) obj >> 4) % __NOCL_INTERNAL_STDATOMIC_LOCKS].lock;
+    while (__sync_lock_test_and_set(lock, 1)) while (*lock);
+
+    nocl_uint128_t current = *(nocl_uint128_t *) &obj->value;
+    res = current.lo == expected->lo && current.hi == expected->hi;
+    if (res) *(nocl_uint128_t *) &obj->value = desired;
+    else *expected = current;
+
+    __sync_lock_release(lock);
+    return res;
+
+#endif
+
+}
+
+static __inline__ nocl_uint128_t atomic_load_uint128(volatile atomic_uint128 *obj) {
+    nocl_uint128_t res = { 0, 0 };
+    atomic_compare_exchange_strong_uint128(obj, &res, res);
+    return res;
+}
+
+static __inline__ void atomic_store_uint128(volatile atomic_uint128 *obj, nocl_uint128_t desired) {
+    nocl_uint128_t expected = { 0, 0 };
+    while (!atomic_compare_exchange_strong_uint128(obj, &expected, desired));
+}
+
+static __inline__ nocl_uint128_t atomic_exchange_uint128(volatile atomic_uint128 *obj, nocl_uint128_t desired) {
+    nocl_uint128_t expected = { 0, 0 };
+    while (!atomic_compare_exchange_strong_uint128(obj, &expected, desired));
+    return expected;
+}
+
+#define atomic_compare_exchange_weak_uint128  atomic_compare_exchange_strong_uint128
+
+#define atomic_load_uint128_explicit(obj,mo)              atomic_load_uint128(obj)
+#define atomic_store_uint128_explicit(obj,desired,mo)     atomic_store_uint128((obj), (desired))
+#define atomic_exchange_uint128_explicit(obj,desired,mo)  atomic_exchange_uint128((obj), (desired))
+
+#define atomic_compare_exchange_strong_uint128_explicit(obj,expected,desired,smo,fmo) \
+    atomic_compare_exchange_strong_uint128((obj), (expected), (desired))
+#define atomic_compare_exchange_weak_uint128_explicit(obj,expected,desired,smo,fmo) \
+    atomic_compare_exchange_strong_uint128((obj), (expected), (desired))
+
+#define atomic_is_lock_free_uint128(obj)  ((void) (obj), __nocl_internal_stdatomic_lock_free16())
+
+#else
+
+#define NOCL_FEATURE_NO_ATOMIC_UINT128
+
+#endif
+
+/*
+ * Atomics on objects of any size, e.g. small structs.
+ *
+ * 'atomic_load_n(obj, ret)', 'atomic_store_n(obj, val)',
+ * 'atomic_exchange_n(obj, val, ret)' and
+ * 'atomic_compare_exchange_n(obj, expected, desired)' take the object and
+ * the values by pointer and work for every 'sizeof(*obj)'. Suitably aligned
+ * objects of 1, 2, 4 and 8 bytes (and of 16 bytes where 'atomic_uint128' is
+ * lock-free) use the native operations. Everything else goes through a
+ * hashed table of padded spin-seqlocks: loads retry instead of writing, and
+ * the other operations hold the stripe briefly. Objects must then only be
+ * accessed through these macros, and compare-exchange compares bytes, so
+ * padding must be zeroed the same way on both sides.
+ *
+ * 'atomic_is_lock_free_n(size, obj)' tells which way an object goes, and
+ * outside the C11 branch 'atomic_is_lock_free' now accounts for alignment.
+ */
+
+#if !defined(NOCL_FEATURE_NO_STDATOMIC)
+
+#include "inttypes.h"
+#include "stdbool.h"
+#include "string.h"
+#include "inline.h"
+#include "callconv.h"
+#include "stdalign.h"
+#include "selectany.h"
+
+#define __NOCL_INTERNAL_STDATOMIC_STRIPES  64
+
+union __nocl_internal_stdatomic_stripe {
+
+#if defined(NOCL_FEATURE_NO_STDALIGN)
+
+    atomic_uint seq;
+
+#else
+
+    alignas(64) atomic_uint seq;
+
+#endif
+
+    char pad[64];
+};
+
+_Selectany union __nocl_internal_stdatomic_stripe __nocl_internal_stdatomic_stripes[__NOCL_INTERNAL_STDATOMIC_STRIPES] = { { 0 } };
+
+static inline atomic_uint *cdecl __nocl_internal_stdatomic_stripe_of(const volatile void *obj) {
+    uintptr_t key = (uintptr_t) obj;
+    return &__nocl_internal_stdatomic_stripes[((key >> 4) ^ (key >> 10)) % __NOCL_INTERNAL_STDATOMIC_STRIPES].seq;
+}
+
+#define __nocl_internal_stdatomic_aligned(obj,size)  (!((uintptr_t) (obj) % (size)))
+
+static inline bool cdecl atomic_is_lock_free_n(size_t size, const volatile void *obj) {
+    switch (size) {
+    case 1:
+    case 2:
+    case 4:
+    case 8:
+        return __nocl_internal_stdatomic_aligned(obj, size);
+
+#if !defined(NOCL_FEATURE_NO_ATOMIC_UINT128)
+
+    case 16:
+        return __nocl_internal_stdatomic_aligned(obj, 16) && __nocl_internal_stdatomic_lock_free16();
+
+#endif
+
+    default:
+        return false;
+    }
+}
+
+#if !defined(__NOCL_INTERNAL_STDATOMIC_SYSTEM)
+
+#undef atomic_is_lock_free
+#define atomic_is_lock_free(obj)  atomic_is_lock_free_n(sizeof(*(obj)), (obj))
+
+#endif
+
+/* Byte copies with relaxed atomics, so that racing readers are not data races. */
+static inline void cdecl __nocl_internal_stdatomic_copy_out(void *dst, const volatile void *src, size_t size) {
+    unsigned char *d = dst;
+    const volatile unsigned char *s = src;
+    for (; size; size --)
+        *d ++ = atomic_load_explicit((volatile atomic_uchar *) s ++, memory_order_relaxed);
+}
+
+static inline void cdecl __nocl_internal_stdatomic_copy_in(volatile void *dst, const void *src, size_t size) {
+    volatile unsigned char *d = dst;
+    const unsigned char *s = src;
+    for (; size; size --)
+        atomic_store_explicit((volatile atomic_uchar *) d ++, *s ++, memory_order_relaxed);
+}
+
+static inline unsigned int cdecl __nocl_internal_stdatomic_stripe_lock(atomic_uint *stripe) {
+    unsigned int seq;
+    for (;;) {
+        seq = atomic_load_explicit(stripe, memory_order_relaxed);
+        if (!(seq & 1) && atomic_compare_exchange_weak_explicit(stripe, &seq, seq + 1, memory_order_acquire, memory_order_relaxed)) break;
+    }
+    /* Keep the data stores from moving above the odd sequence. */
+    atomic_thread_fence(memory_order_release);
+    return seq + 2;
+}
+
+#define __nocl_internal_stdatomic_native_case(bits,op) \
+    case bits / 8: { \
+        uint##bits##_t value, other; \
+        (void) value; \
+        (void) other; \
+        op(volatile atomic_uint_least##bits##_t); \
+        break; \
+    }
+
+#if !defined(NOCL_FEATURE_NO_ATOMIC_UINT128)
+
+#define __nocl_internal_stdatomic_native_cases(op,op128) \
+    __nocl_internal_stdatomic_native_case(8, op) \
+    __nocl_internal_stdatomic_native_case(16, op) \
+    __nocl_internal_stdatomic_native_case(32, op) \
+    __nocl_internal_stdatomic_native_case(64, op) \
+    case 16: { \
+        nocl_uint128_t value, other; \
+        (void) value; \
+        (void) other; \
+        op128; \
+        break; \
+    }
+
+#else
+
+#define __nocl_internal_stdatomic_native_cases(op,op128) \
+    __nocl_internal_stdatomic_native_case(8, op) \
+    __nocl_internal_stdatomic_native_case(16, op) \
+    __nocl_internal_stdatomic_native_case(32, op) \
+    __nocl_internal_stdatomic_native_case(64, op)
+
+#endif
+
+#define __nocl_internal_stdatomic_load_op(type) \
+    value = atomic_load_explicit((type *) obj, mo); \
+    memcpy(ret, &value, size)
+
+static inline void cdecl __nocl_internal_stdatomic_load_n(size_t size, const volatile void *obj, void *ret, memory_order mo) {
+    atomic_uint *stripe;
+    unsigned int seq;
+
+    if (atomic_is_lock_free_n(size, obj)) {
+
+        switch (size) {
+        __nocl_internal_stdatomic_native_cases(__nocl_internal_stdatomic_load_op,
+            value = atomic_load_uint128((volatile atomic_uint128 *) obj); memcpy(ret, &value, 16))
+        }
+
+        return;
+    }
+
+    stripe = __nocl_internal_stdatomic_stripe_of(obj);
+    for (;;) {
+        seq = atomic_load_explicit(stripe, memory_order_acquire);
+        if (seq & 1) continue;
+        __nocl_internal_stdatomic_copy_out(ret, obj, size);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(stripe, memory_order_relaxed) == seq) break;
+    }
+    if (mo == memory_order_seq_cst) atomic_thread_fence(memory_order_seq_cst);
+}
+
+#define __nocl_internal_stdatomic_exchange_op(type) \
+    memcpy(&value, val, size); \
+    if (ret) { \
+        other = atomic_exchange_explicit((type *) obj, value, mo); \
+        memcpy(ret, &other, size); \
+    } \
+    else atomic_store_explicit((type *) obj, value, mo)
+
+static inline void cdecl __nocl_internal_stdatomic_exchange_n(size_t size, volatile void *obj, const void *val, void *ret, memory_order mo) {
+    atomic_uint *stripe;
+    unsigned int seq;
+
+    if (atomic_is_lock_free_n(size, obj)) {
+
+        switch (size) {
+        __nocl_internal_stdatomic_native_cases(__nocl_internal_stdatomic_exchange_op,
+            memcpy(&value, val, 16); other = atomic_exchange_uint128((volatile atomic_uint128 *) obj, value); if (ret) memcpy(ret, &other, 16))
+        }
+
+        return;
+    }
+
+    if (mo == memory_order_seq_cst) atomic_thread_fence(memory_order_seq_cst);
+    stripe = __nocl_internal_stdatomic_stripe_of(obj);
+    seq = __nocl_internal_stdatomic_stripe_lock(stripe);
+    if (ret) __nocl_internal_stdatomic_copy_out(ret, obj, size);
+    __nocl_internal_stdatomic_copy_in(obj, val, size);
+    atomic_store_explicit(stripe, seq, memory_order_release);
+    if (mo == memory_order_seq_cst) atomic_thread_fence(memory_order_seq_cst);
+}
+
+#define __nocl_internal_stdatomic_compare_exchange_op(type) \
+    memcpy(&value, expected, size); \
+    memcpy(&other, desired, size); \
+    res = atomic_compare_exchange_strong_explicit((type *) obj, &value, other, smo, fmo); \
+    memcpy(expected, &value, size)
+
+static inline bool cdecl __nocl_internal_stdatomic_compare_exchange_n(size_t size, volatile void *obj, void *expected, const void *desired, memory_order smo, memory_order fmo) {
+    atomic_uint *stripe;
+    unsigned int seq;
+    unsigned char current[64];
+    bool res = true;
+    size_t chunk, done;
+
+    if (atomic_is_lock_free_n(size, obj)) {
+
+        switch (size) {
+        __nocl_internal_stdatomic_native_cases(__nocl_internal_stdatomic_compare_exchange_op,
+            memcpy(&value, expected, 16); memcpy(&other, desired, 16);
+            res = atomic_compare_exchange_strong_uint128((volatile atomic_uint128 *) obj, &value, other);
+            memcpy(expected, &value, 16))
+        }
+
+        return res;
+    }
+
+    if (smo == memory_order_seq_cst) atomic_thread_fence(memory_order_seq_cst);
+    stripe = __nocl_internal_stdatomic_stripe_of(obj);
+    seq = __nocl_internal_stdatomic_stripe_lock(stripe);
+
+    /* Compare in chunks so that any size works without a heap buffer. */
+    for (done = 0; done < size && res; done += chunk) {
+        chunk = size - done < sizeof(current) ? size - done : sizeof(current);
+        __nocl_internal_stdatomic_copy_out(current, (const volatile unsigned char *) obj + done, chunk);
+        res = !memcmp(current, (unsigned char *) expected + done, chunk);
+    }
+    if (res) __nocl_internal_stdatomic_copy_in(obj, desired, size);
+    else __nocl_internal_stdatomic_copy_out(expected, obj, size);
+
+    atomic_store_explicit(stripe, seq, memory_order_release);
+    if ((res ? smo : fmo) == memory_order_seq_cst) atomic_thread_fence(memory_order_seq_cst);
+    return res;
+}
+
+#define atomic_load_n_explicit(obj,ret,mo) \
+    __nocl_internal_stdatomic_load_n(sizeof(*(obj)), (obj), (ret), (mo))
+#define atomic_store_n_explicit(obj,val,mo) \
+    __nocl_internal_stdatomic_exchange_n(sizeof(*(obj)), (obj), (val), NULL, (mo))
+#define atomic_exchange_n_explicit(obj,val,ret,mo) \
+    __nocl_internal_stdatomic_exchange_n(sizeof(*(obj)), (obj), (val), (ret), (mo))
+#define atomic_compare_exchange_n_explicit(obj,expected,desired,smo,fmo) \
+    __nocl_internal_stdatomic_compare_exchange_n(sizeof(*(obj)), (obj), (expected), (desired), (smo), (fmo))
+
+#define atomic_load_n(obj,ret)          atomic_load_n_explicit((obj), (ret), memory_order_seq_cst)
+#define atomic_store_n(obj,val)         atomic_store_n_explicit((obj), (val), memory_order_seq_cst)
+#define atomic_exchange_n(obj,val,ret)  atomic_exchange_n_explicit((obj), (val), (ret), memory_order_seq_cst)
+#define atomic_compare_exchange_n(obj,expected,desired) \
+    atomic_compare_exchange_n_explicit((obj), (expected), (desired), memory_order_seq_cst, memory_order_seq_cst)
+
+#endif
+
+/*
+ * Blocking on atomics: 'atomic_wait' sleeps while a 32- or 64-bit integer
+ * atomic still holds 'old', and 'atomic_notify_one'/'atomic_notify_all'
+ * wake threads waiting on it after it was changed.
+ *
+ * On Linux, 32-bit objects are futexes themselves, and 8-, 16- and 64-bit
+ * objects wait on a sequence word in a hashed bucket. Elsewhere, each bucket is a
+ * condition variable. Buckets count their waiters, so a notify with nobody
+ * waiting is one load and never a system call. Wakeups may be spurious on
+ * the shared paths, which the waiter absorbs by checking the value again.
+ */
+
+#if !defined(NOCL_FEATURE_NO_STDATOMIC)
+
+#include "inline.h"
+#include "callconv.h"
+#include "inttypes.h"
+#include "selectany.h"
+
+#if defined(__linux__)
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <limits.h>
+
+#if defined(SYS_futex) && \
+    (defined(_GNU_SOURCE) || defined(_DEFAULT_SOURCE) || defined(_BSD_SOURCE) || defined(__USE_MISC))
+
+#define __NOCL_INTERNAL_STDATOMIC_HAS_FUTEX
+
+#endif
+
+#endif
+
+#if !defined(__NOCL_INTERNAL_STDATOMIC_HAS_FUTEX)
+
+#include "threads.h"
+
+#endif
+
+#if defined(__NOCL_INTERNAL_STDATOMIC_HAS_FUTEX) || !defined(NOCL_FEATURE_NO_THREADS)
+
+#define __NOCL_INTERNAL_STDATOMIC_WAIT_BUCKETS  64
+
+struct __nocl_internal_stdatomic_wait_bucket {
+    atomic_uint waiters;
+
+#if defined(__NOCL_INTERNAL_STDATOMIC_HAS_FUTEX)
+
+    atomic_uint seq;
+
+#else
+
+    mtx_t lock;
+    cnd_t cond;
+
+#endif
+
+};
+
+/* Padded so that neighbouring buckets do not share a cache line. */
+union __nocl_internal_stdatomic_wait_slot {
+    struct __nocl_internal_stdatomic_wait_bucket bucket;
+    char pad[64 * ((sizeof(struct __nocl_internal_stdatomic_wait_bucket) + 63) / 64)];
+};
+
+_Selectany union __nocl_internal_stdatomic_wait_slot __nocl_internal_stdatomic_wait_table[__NOCL_INTERNAL_STDATOMIC_WAIT_BUCKETS] = { { { 0 } } };
+
+static inline struct __nocl_internal_stdatomic_wait_bucket *cdecl __nocl_internal_stdatomic_wait_bucket_of(const volatile void *obj) {
+    uintptr_t key = (uintptr_t) obj;
+    return &__nocl_internal_stdatomic_wait_table[((key >> 3) ^ (key >> 9)) % __NOCL_INTERNAL_STDATOMIC_WAIT_BUCKETS].bucket;
+}
+
+#define __nocl_internal_stdatomic_wait_load(obj,bits,mo) \
+    atomic_load_explicit((volatile atomic_uint_least##bits##_t *) (obj), (mo))
+
+/* Loads an 8-, 16-, 32- or 64-bit object zero-extended, to compare against a truncated 'old'. */
+static inline uint64_t cdecl __nocl_internal_stdatomic_wait_value(const volatile void *obj, int bits, memory_order mo) {
+    switch (bits) {
+    case 8: return __nocl_internal_stdatomic_wait_load(obj, 8, mo);
+    case 16: return __nocl_internal_stdatomic_wait_load(obj, 16, mo);
+    case 32: return __nocl_internal_stdatomic_wait_load(obj, 32, mo);
+    default: return __nocl_internal_stdatomic_wait_load(obj, 64, mo);
+    }
+}
+
+#define __nocl_internal_stdatomic_wait_truncate(old,bits) \
+    ((bits) < 64 ? (old) & ((UINT64_C(1) << ((bits) & 63)) - 1) : (old))
+
+#if defined(__NOCL_INTERNAL_STDATOMIC_HAS_FUTEX)
+
+#define __NOCL_INTERNAL_STDATOMIC_FUTEX_WAIT  128  /* FUTEX_WAIT | FUTEX_PRIVATE_FLAG */
+#define __NOCL_INTERNAL_STDATOMIC_FUTEX_WAKE  129  /* FUTEX_WAKE | FUTEX_PRIVATE_FLAG */
+
+static inline void cdecl __nocl_internal_stdatomic_wait32(const volatile void *obj, uint32_t old, memory_order mo) {
+    struct __nocl_internal_stdatomic_wait_bucket *bucket;
+
+    if (__nocl_internal_stdatomic_wait_load(obj, 32, mo) != old) return;
+
+    bucket = __nocl_internal_stdatomic_wait_bucket_of(obj);
+    atomic_fetch_add_explicit(&bucket->waiters, 1, memory_order_seq_cst);
+    while (__nocl_internal_stdatomic_wait_load(obj, 32, memory_order_seq_cst) == old)
+        syscall(SYS_futex, obj, __NOCL_INTERNAL_STDATOMIC_FUTEX_WAIT, old, NULL, NULL, 0);
+    atomic_fetch_sub_explicit(&bucket->waiters, 1, memory_order_relaxed);
+}
+
+/* The kernel only compares aligned 32-bit words, so other sizes wait on the bucket's sequence instead. */
+static inline void cdecl __nocl_internal_stdatomic_waitn(const volatile void *obj, uint64_t old, int bits, memory_order mo) {
+    struct __nocl_internal_stdatomic_wait_bucket *bucket;
+    unsigned int seq;
+
+    old = __nocl_internal_stdatomic_wait_truncate(old, bits);
+    if (__nocl_internal_stdatomic_wait_value(obj, bits, mo) != old) return;
+
+    bucket = __nocl_internal_stdatomic_wait_bucket_of(obj);
+    atomic_fetch_add_explicit(&bucket->waiters, 1, memory_order_seq_cst);
+    for (;;) {
+        seq = atomic_load_explicit(&bucket->seq, memory_order_seq_cst);
+        if (__nocl_internal_stdatomic_wait_value(obj, bits, memory_order_seq_cst) != old) break;
+        syscall(SYS_futex, &bucket->seq, __NOCL_INTERNAL_STDATOMIC_FUTEX_WAIT, seq, NULL, NULL, 0);
+    }
+    atomic_fetch_sub_explicit(&bucket->waiters, 1, memory_order_relaxed);
+}
+
+static inline void cdecl __nocl_internal_stdatomic_notify(const volatile void *obj, int bits, int all) {
+    struct __nocl_internal_stdatomic_wait_bucket *bucket = __nocl_internal_stdatomic_wait_bucket_of(obj);
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&bucket->waiters, memory_order_relaxed)) return;
+
+    if (bits == 32) {
+        syscall(SYS_futex, obj, __NOCL_INTERNAL_STDATOMIC_FUTEX_WAKE, all ? INT_MAX : 1, NULL, NULL, 0);
+    }
+    else {
+        /* Other objects may share the bucket, so everyone has to look. */
+        atomic_fetch_add_explicit(&bucket->seq, 1, memory_order_seq_cst);
+        syscall(SYS_futex, &bucket->seq, __NOCL_INTERNAL_STDATOMIC_FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+#else
+
+_Selectany once_flag __nocl_internal_stdatomic_wait_once = ONCE_FLAG_INIT;
+
+static inline void cdecl __nocl_internal_stdatomic_wait_init(void) {
+    size_t i;
+    for (i = 0; i < __NOCL_INTERNAL_STDATOMIC_WAIT_BUCKETS; i ++) {
+        mtx_init(&__nocl_internal_stdatomic_wait_table[i].bucket.lock, mtx_plain);
+        cnd_init(&__nocl_internal_stdatomic_wait_table[i].bucket.cond);
+    }
+}
+
+static inline void cdecl __nocl_internal_stdatomic_waitn(const volatile void *obj, uint64_t old, int bits, memory_order mo) {
+    struct __nocl_internal_stdatomic_wait_bucket *bucket;
+
+    old = __nocl_internal_stdatomic_wait_truncate(old, bits);
+    if (__nocl_internal_stdatomic_wait_value(obj, bits, mo) != old) return;
+
+    call_once(&__nocl_internal_stdatomic_wait_once, __nocl_internal_stdatomic_wait_init);
+    bucket = __nocl_internal_stdatomic_wait_bucket_of(obj);
+    mtx_lock(&bucket->lock);
+    atomic_fetch_add_explicit(&bucket->waiters, 1, memory_order_seq_cst);
+    while (__nocl_internal_stdatomic_wait_value(obj, bits, memory_order_seq_cst) == old)
+        cnd_wait(&bucket->cond, &bucket->lock);
+    atomic_fetch_sub_explicit(&bucket->waiters, 1, memory_order_relaxed);
+    mtx_unlock(&bucket->lock);
+}
+
+static inline void cdecl __nocl_internal_stdatomic_wait32(const volatile void *obj, uint32_t old, memory_order mo) {
+    __nocl_internal_stdatomic_waitn(obj, old, 32, mo);
+}
+
+/* Buckets are shared, so even 'atomic_notify_one' has to wake everyone in it. */
+static inline void cdecl __nocl_internal_stdatomic_notify(const volatile void *obj, int bits, int all) {
+    struct __nocl_internal_stdatomic_wait_bucket *bucket = __nocl_internal_stdatomic_wait_bucket_of(obj);
+
+    (void) bits;
+    (void) all;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&bucket->waiters, memory_order_relaxed)) return;
+
+    /* Waiters only add themselves under the lock, so the table is initialized. */
+    mtx_lock(&bucket->lock);
+    cnd_broadcast(&bucket->cond);
+    mtx_unlock(&bucket->lock);
+}
+
+#endif
+
+/* Only 1-, 2-, 4- and 8-byte objects can be waited on; anything else does not compile. */
+#define __nocl_internal_stdatomic_wait_bits(obj) \
+    ((int) sizeof(char [(sizeof(*(obj)) == 1 || sizeof(*(obj)) == 2 || sizeof(*(obj)) == 4 || sizeof(*(obj)) == 8) ? 1 : -1]) * \
+    (int) sizeof(*(obj)) * 8)
+
+#define atomic_wait_explicit(obj,old,mo) \
+    (__nocl_internal_stdatomic_wait_bits(obj) == 32 ? \
+    __nocl_internal_stdatomic_wait32((obj), (uint32_t) (old), (mo)) : \
+    __nocl_internal_stdatomic_waitn((obj), (uint64_t) (old), __nocl_internal_stdatomic_wait_bits(obj), (mo)))
+
+#define atomic_wait(obj,old)  atomic_wait_explicit((obj), (old), memory_order_seq_cst)
+
+#define atomic_notify_one(obj)  __nocl_internal_stdatomic_notify((obj), __nocl_internal_stdatomic_wait_bits(obj), 0)
+#define atomic_notify_all(obj)  __nocl_internal_stdatomic_notify((obj), __nocl_internal_stdatomic_wait_bits(obj), 1)
+
+#else
+
+#define NOCL_FEATURE_NO_ATOMIC_WAIT
+
+#endif
+
+#else
+
+#define NOCL_FEATURE_NO_ATOMIC_WAIT
+
+#endif
+
 #if defined(__cplusplus)
 
 }
@@ -39,6 +39,8 @@ extern "C" {
 
 #endif
 
+#include "callconv.h"
+
 #if defined(NOCL_HAS_THREADS_H) || \
     /* C11 */ (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__) && !defined(__MINGW32__))
 
@@ -46,7 +48,7 @@ extern "C" {
 
 #elif /* Win32 */ defined(_WIN32) && \
 	/* MSVC 2.0 */ ((defined(_MSC_VER) && _MSC_VER >= 900) || \
-	/* MinGW/MinGW-w64 GCC 3.2.0 */ defined(__MINGW32__)
+	/* MinGW/MinGW-w64 GCC 3.2.0 */ defined(__MINGW32__))
 
 #include "time.h"
 #include "stdlib.h"
@@ -806,7 +808,7 @@ __inline void __cdecl call_once(once_flag *flag, void (*func) (void)) {
 #endif
 
 #elif \
-	/* GCC 3.3.0 */ (defined(__GNUC__) && (__GNUC__ >= 4 || (defined(__GNUC_MINOR__) && __GNUC__ == 3 && __GNUC_MINOR__ >= 3))) \
+	/* GCC 3.3.0 */ (defined(__GNUC__) && (__GNUC__ >= 4 || (defined(__GNUC_MINOR__) && __GNUC__ == 3 && __GNUC_MINOR__ >= 3))) && \
 	/* POSIX.1-2001 */ ((defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200112L) || \
 	/* UNIX03 */ (defined(_XOPEN_SOURCE) && _XOPEN_SOURCE >= 600))
 
@@ -1034,6 +1036,240 @@ __inline__ void call_once(once_flag *flag, void (*func) (void)) {
 
 #endif
 
+/*
+ * Adaptive mutexes.
+ *
+ * An 'amtx_t' is taken with one compare-exchange when free. Under
+ * contention the caller first spins, pausing the CPU for exponentially
+ * longer stretches between checks, and only parks once the spin budget
+ * is used up: on a futex on Linux, elsewhere on a 'cnd_t' inside the
+ * mutex. The budget tracks how long recent acquisitions had to spin, so it
+ * grows while holders release quickly and shrinks when spinning does not
+ * pay off. 'amtx_t' is not recursive and has no timed lock.
+ */
+
+#if !defined(NOCL_FEATURE_NO_THREADS)
+
+#if defined(_MSC_VER)
+
+#include <intrin.h>
+
+typedef long __nocl_internal_threads_word;
+
+#define __nocl_internal_threads_load(ptr)      (*(ptr))
+#define __nocl_internal_threads_store(ptr,val) (*(ptr) = (val))
+#define __nocl_internal_threads_cas(ptr,o,n)   (_InterlockedCompareExchange((ptr), (n), (o)) == (o))
+#define __nocl_internal_threads_xchg(ptr,val)  _InterlockedExchange((ptr), (val))
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+#define __nocl_internal_threads_pause()  _mm_pause()
+
+#elif defined(_M_ARM) || defined(_M_ARM64)
+
+#define __nocl_internal_threads_pause()  __yield()
+
+#else
+
+#define __nocl_internal_threads_pause()  ((void) 0)
+
+#endif
+
+#elif /* GCC 4.1.0 */ (defined(__GNUC__) && (__GNUC__ >= 5 || (defined(__GNUC_MINOR__) && __GNUC__ == 4 && __GNUC_MINOR__ >= 1)))
+
+typedef int __nocl_internal_threads_word;
+
+#if /* GCC 4.7.0 */ __GNUC__ >= 5 || __GNUC_MINOR__ >= 7
+
+#define __nocl_internal_threads_load(ptr)       __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define __nocl_internal_threads_store(ptr,val)  __atomic_store_n((ptr), (val), __ATOMIC_RELAXED)
+
+static __inline__ int __nocl_internal_threads_cas(volatile int *ptr, int expected, int desired) {
+	return __atomic_compare_exchange_n(ptr, &expected, desired, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+#define __nocl_internal_threads_xchg(ptr,val)  __atomic_exchange_n((ptr), (val), __ATOMIC_ACQ_REL)
+
+#else
+
+#define __nocl_internal_threads_load(ptr)      (*(ptr))
+#define __nocl_internal_threads_store(ptr,val) (*(ptr) = (val))
+#define __nocl_internal_threads_cas(ptr,o,n)   __sync_bool_compare_and_swap((ptr), (o), (n))
+#define __nocl_internal_threads_xchg(ptr,val)  (__sync_synchronize(), __sync_lock_test_and_set((ptr), (val)))
+
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#define __nocl_internal_threads_pause()  __asm__ __volatile__("pause")
+
+#elif defined(__aarch64__) || defined(__arm__)
+
+#define __nocl_internal_threads_pause()  __asm__ __volatile__("yield")
+
+#else
+
+#define __nocl_internal_threads_pause()  __asm__ __volatile__("" ::: "memory")
+
+#endif
+
+#else
+
+#define NOCL_FEATURE_NO_AMTX
+
+#endif
+
+#if !defined(NOCL_FEATURE_NO_AMTX)
+
+#if defined(__linux__) && defined(__GNUC__)
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#if defined(SYS_futex) && \
+	(defined(_GNU_SOURCE) || defined(_DEFAULT_SOURCE) || defined(_BSD_SOURCE) || defined(__USE_MISC))
+
+#define __NOCL_INTERNAL_THREADS_HAS_FUTEX
+
+#define __NOCL_INTERNAL_THREADS_FUTEX_WAIT  128  /* FUTEX_WAIT | FUTEX_PRIVATE_FLAG */
+#define __NOCL_INTERNAL_THREADS_FUTEX_WAKE  129  /* FUTEX_WAKE | FUTEX_PRIVATE_FLAG */
+
+#endif
+
+#endif
+
+#if !defined(NOCL_AMTX_SPIN_MAX)
+
+#define NOCL_AMTX_SPIN_MAX  4096  /* Pause instructions, roughly 10 to 150 us depending on the CPU. */
+
+#endif
+
+#define __NOCL_INTERNAL_THREADS_AMTX_BACKOFF_MAX  64
+
+typedef struct amtx_t {
+	/* 0 when free, 1 when held, 2 when held and someone may be parked. */
+	volatile __nocl_internal_threads_word state;
+
+	/* Written only by the holder, read by waiters; both with relaxed atomics. */
+	volatile __nocl_internal_threads_word spins;
+
+#if !defined(__NOCL_INTERNAL_THREADS_HAS_FUTEX)
+
+	mtx_t lock;
+	cnd_t cond;
+
+#endif
+
+} amtx_t;
+
+static __inline int cdecl amtx_init(amtx_t *mtx) {
+	mtx->state = 0;
+	mtx->spins = 0;
+
+#if !defined(__NOCL_INTERNAL_THREADS_HAS_FUTEX)
+
+	if (mtx_init(&mtx->lock, mtx_plain) != thrd_success) return thrd_error;
+	if (cnd_init(&mtx->cond) != thrd_success) {
+		mtx_destroy(&mtx->lock);
+		return thrd_error;
+	}
+
+#endif
+
+	return thrd_success;
+}
+
+static __inline void cdecl amtx_destroy(amtx_t *mtx) {
+
+#if !defined(__NOCL_INTERNAL_THREADS_HAS_FUTEX)
+
+	cnd_destroy(&mtx->cond);
+	mtx_destroy(&mtx->lock);
+
+#else
+
+	(void) mtx;
+
+#endif
+
+}
+
+/* Sleep while the state is still 2. */
+static __inline void cdecl __nocl_internal_threads_amtx_park(amtx_t *mtx) {
+
+#if defined(__NOCL_INTERNAL_THREADS_HAS_FUTEX)
+
+	syscall(SYS_futex, &mtx->state, __NOCL_INTERNAL_THREADS_FUTEX_WAIT, 2, NULL, NULL, 0);
+
+#else
+
+	mtx_lock(&mtx->lock);
+	if (__nocl_internal_threads_load(&mtx->state) == 2) cnd_wait(&mtx->cond, &mtx->lock);
+	mtx_unlock(&mtx->lock);
+
+#endif
+
+}
+
+static __inline void cdecl __nocl_internal_threads_amtx_wake(amtx_t *mtx) {
+
+#if defined(__NOCL_INTERNAL_THREADS_HAS_FUTEX)
+
+	syscall(SYS_futex, &mtx->state, __NOCL_INTERNAL_THREADS_FUTEX_WAKE, 1, NULL, NULL, 0);
+
+#else
+
+	/* Taking the lock orders this after a parker's check of the state. */
+	mtx_lock(&mtx->lock);
+	cnd_signal(&mtx->cond);
+	mtx_unlock(&mtx->lock);
+
+#endif
+
+}
+
+static __inline int cdecl amtx_trylock(amtx_t *mtx) {
+	return __nocl_internal_threads_cas(&mtx->state, 0, 1) ? thrd_success : thrd_busy;
+}
+
+static __inline int cdecl amtx_lock(amtx_t *mtx) {
+	int limit, spun, backoff, spins, i;
+
+	if (__nocl_internal_threads_cas(&mtx->state, 0, 1)) return thrd_success;
+
+	/* Allow twice what recent acquisitions needed, so the budget can grow back. */
+	limit = (int) __nocl_internal_threads_load(&mtx->spins) * 2 + 16;
+	if (limit > NOCL_AMTX_SPIN_MAX) limit = NOCL_AMTX_SPIN_MAX;
+
+	for (spun = 0, backoff = 1; spun < limit; spun += backoff) {
+		for (i = 0; i < backoff; i ++)
+			__nocl_internal_threads_pause();
+		if (backoff < __NOCL_INTERNAL_THREADS_AMTX_BACKOFF_MAX) backoff <<= 1;
+
+		if (!__nocl_internal_threads_load(&mtx->state) && __nocl_internal_threads_cas(&mtx->state, 0, 1)) {
+			spins = (int) __nocl_internal_threads_load(&mtx->spins);
+			__nocl_internal_threads_store(&mtx->spins, spins + (spun - spins) / 8);
+			return thrd_success;
+		}
+	}
+
+	/* Spinning did not pay off; from here on, mark the mutex as having sleepers. */
+	while (__nocl_internal_threads_xchg(&mtx->state, 2))
+		__nocl_internal_threads_amtx_park(mtx);
+	spins = (int) __nocl_internal_threads_load(&mtx->spins);
+	__nocl_internal_threads_store(&mtx->spins, spins - spins / 8);
+	return thrd_success;
+}
+
+static __inline int cdecl amtx_unlock(amtx_t *mtx) {
+	if (__nocl_internal_threads_xchg(&mtx->state, 0) == 2) __nocl_internal_threads_amtx_wake(mtx);
+	return thrd_success;
+}
+
+#endif
+
+#endif
+
 #if defined(__cplusplus)
 
 }